@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 199309L
+#include "bench.h"
+#include <stdlib.h>
+#include <time.h>
+
+static int g_bench_report_count = 0;
+
+double bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int bench_samples_compare(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+void bench_samples_summarize(double* samples, int count, double* best_out,
+                             double* median_out)
+{
+    qsort(samples, (size_t)count, sizeof(double), bench_samples_compare);
+    *best_out = samples[0];
+    *median_out = (count % 2 == 1)
+                      ? samples[count / 2]
+                      : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+}
+
+void bench_report_begin(FILE* fp, size_t size, int repetitions, int warmup)
+{
+    g_bench_report_count = 0;
+    fprintf(fp,
+            "{\n  \"size\": %lu,\n  \"repetitions\": %d,\n  \"warmup\": %d,\n"
+            "  \"results\": [",
+            (unsigned long)size, repetitions, warmup);
+}
+
+/* Throughput from the median, which is steadier than the best run */
+void bench_report_result(FILE* fp, const bench_result_t* result)
+{
+    double mb_per_s = 0;
+    double ns_per_op = 0;
+    if (result->median_ns > 0)
+    {
+        mb_per_s = (double)result->bytes / (result->median_ns / 1e9) / 1e6;
+    }
+    if (result->ops != 0)
+    {
+        ns_per_op = result->median_ns / (double)result->ops;
+    }
+    fprintf(fp,
+            "%s\n    {\"corpus\": \"%s\", \"op\": \"%s\", \"bytes\": %lu, "
+            "\"ops\": %lu, \"best_ns\": %.0f, \"median_ns\": %.0f, "
+            "\"mb_per_s\": %.2f, \"ns_per_op\": %.2f}",
+            (g_bench_report_count == 0) ? "" : ",", result->corpus,
+            result->op, (unsigned long)result->bytes,
+            (unsigned long)result->ops, result->best_ns, result->median_ns,
+            mb_per_s, ns_per_op);
+    g_bench_report_count++;
+}
+
+void bench_report_scaling(FILE* fp, const bench_scaling_result_t* result)
+{
+    double mb_per_s = 0;
+    if (result->wall_ns > 0)
+    {
+        mb_per_s = (double)result->bytes * (double)result->documents /
+                   (result->wall_ns / 1e9) / 1e6;
+    }
+    fprintf(fp,
+            "%s\n    {\"corpus\": \"%s\", \"op\": \"scaling\", "
+            "\"allocator\": \"%s\", \"threads\": %d, \"bytes\": %lu, "
+            "\"documents\": %lu, \"wall_ns\": %.0f, \"mb_per_s\": %.2f, "
+            "\"efficiency\": %.3f}",
+            (g_bench_report_count == 0) ? "" : ",", result->corpus,
+            result->allocator, result->threads, (unsigned long)result->bytes,
+            (unsigned long)result->documents, result->wall_ns, mb_per_s,
+            result->efficiency);
+    g_bench_report_count++;
+}
+
+void bench_report_end(FILE* fp) { fprintf(fp, "\n  ]\n}\n"); }
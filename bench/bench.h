@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct
+{
+    size_t size;
+    int repetitions;
+    int warmup;
+    const char* corpus;
+    /* Thread scaling runs up to this many threads, 0 for the single
+     * threaded operation timings */
+    int threads;
+    const char* allocator;
+} bench_options_t;
+
+/* Timings of one operation on one corpus over all repetitions */
+typedef struct
+{
+    const char* corpus;
+    const char* op;
+    /* Bytes and operations handled by a single repetition */
+    size_t bytes;
+    size_t ops;
+    int repetitions;
+    double best_ns;
+    double median_ns;
+} bench_result_t;
+
+/* Documents handled per second by a number of threads, each working on
+ * its own copy of the corpus */
+typedef struct
+{
+    const char* corpus;
+    const char* allocator;
+    int threads;
+    size_t bytes;
+    size_t documents;
+    double wall_ns;
+    /* Throughput per thread relative to the single thread run */
+    double efficiency;
+} bench_scaling_result_t;
+
+double bench_now_ns(void);
+
+/* Best and median of count samples, which get sorted */
+void bench_samples_summarize(double* samples, int count, double* best_out,
+                             double* median_out);
+
+/* Results are written as one JSON document:
+ * {"size":..,"repetitions":..,"warmup":..,"results":[{..},..]} */
+void bench_report_begin(FILE* fp, size_t size, int repetitions, int warmup);
+void bench_report_result(FILE* fp, const bench_result_t* result);
+void bench_report_scaling(FILE* fp, const bench_scaling_result_t* result);
+void bench_report_end(FILE* fp);
+
+#endif
@@ -0,0 +1,187 @@
+#include "bench_alloc.h"
+#include <stdlib.h>
+
+/* Every block starts with a header that keeps the payload aligned */
+#define BENCH_ALLOC_ALIGN 16
+#define BENCH_ALLOC_HEADER 16
+#define BENCH_CHUNK_HEADER 32
+#define BENCH_POOL_CLASS_SIZE 16
+#define BENCH_POOL_CLASSES 32
+#define BENCH_POOL_CHUNK_SIZE (64 * 1024)
+#define BENCH_ARENA_CHUNK_SIZE (1024 * 1024)
+
+/* System malloc */
+
+static void bench_alloc_noop(void) {}
+
+/* Per-thread pools: size classes of 16 bytes up to 512, each with a free
+ * list refilled from chunks owned by the thread; larger blocks go to
+ * malloc. The class is kept in the header so that free needs no size */
+
+typedef struct bench_pool_block
+{
+    struct bench_pool_block* next;
+} bench_pool_block_t;
+
+typedef struct bench_chunk
+{
+    struct bench_chunk* next;
+    size_t size;
+    size_t used;
+} bench_chunk_t;
+
+static __thread bench_pool_block_t* g_bench_pool_free[BENCH_POOL_CLASSES];
+static __thread bench_chunk_t* g_bench_pool_chunks = NULL;
+
+static void* bench_pool_malloc(ujson_size_t size)
+{
+    size_t cls = (size + BENCH_POOL_CLASS_SIZE - 1) / BENCH_POOL_CLASS_SIZE;
+    size_t block_size;
+    char* p;
+    bench_chunk_t* chunk;
+    /* Room for the free list link */
+    if (cls == 0)
+    {
+        cls = 1;
+    }
+    if (cls >= BENCH_POOL_CLASSES)
+    {
+        if ((p = malloc(BENCH_ALLOC_HEADER + size)) == NULL)
+        {
+            return NULL;
+        }
+        *(size_t*)p = BENCH_POOL_CLASSES;
+        return p + BENCH_ALLOC_HEADER;
+    }
+    if (g_bench_pool_free[cls] != NULL)
+    {
+        p = (char*)g_bench_pool_free[cls];
+        g_bench_pool_free[cls] = g_bench_pool_free[cls]->next;
+        return p;
+    }
+    block_size = BENCH_ALLOC_HEADER + cls * BENCH_POOL_CLASS_SIZE;
+    chunk = g_bench_pool_chunks;
+    if ((chunk == NULL) || (chunk->used + block_size > chunk->size))
+    {
+        if ((chunk = malloc(BENCH_POOL_CHUNK_SIZE)) == NULL)
+        {
+            return NULL;
+        }
+        chunk->next = g_bench_pool_chunks;
+        chunk->size = BENCH_POOL_CHUNK_SIZE;
+        chunk->used = BENCH_CHUNK_HEADER;
+        g_bench_pool_chunks = chunk;
+    }
+    p = (char*)chunk + chunk->used;
+    chunk->used += block_size;
+    *(size_t*)p = cls;
+    return p + BENCH_ALLOC_HEADER;
+}
+
+static void bench_pool_free(void* ptr)
+{
+    char* p = (char*)ptr - BENCH_ALLOC_HEADER;
+    size_t cls = *(size_t*)p;
+    if (cls == BENCH_POOL_CLASSES)
+    {
+        free(p);
+        return;
+    }
+    ((bench_pool_block_t*)ptr)->next = g_bench_pool_free[cls];
+    g_bench_pool_free[cls] = (bench_pool_block_t*)ptr;
+}
+
+static void bench_pool_release(void)
+{
+    bench_chunk_t* chunk;
+    size_t i;
+    while ((chunk = g_bench_pool_chunks) != NULL)
+    {
+        g_bench_pool_chunks = chunk->next;
+        free(chunk);
+    }
+    for (i = 0; i != BENCH_POOL_CLASSES; i++)
+    {
+        g_bench_pool_free[i] = NULL;
+    }
+}
+
+/* Per-thread arenas: bump allocation out of chunks, free does nothing and
+ * the chunks are rewound for reuse after each document */
+
+static __thread bench_chunk_t* g_bench_arena_chunks = NULL;
+static __thread bench_chunk_t* g_bench_arena_current = NULL;
+
+static void* bench_arena_malloc(ujson_size_t size)
+{
+    bench_chunk_t* chunk = g_bench_arena_current;
+    size_t block_size =
+        (size + BENCH_ALLOC_ALIGN - 1) / BENCH_ALLOC_ALIGN * BENCH_ALLOC_ALIGN;
+    size_t chunk_size;
+    char* p;
+    /* Chunks left over from earlier documents are used in order */
+    while ((chunk != NULL) && (chunk->used + block_size > chunk->size))
+    {
+        chunk = chunk->next;
+    }
+    if (chunk == NULL)
+    {
+        chunk_size = BENCH_CHUNK_HEADER + block_size;
+        if (chunk_size < BENCH_ARENA_CHUNK_SIZE)
+        {
+            chunk_size = BENCH_ARENA_CHUNK_SIZE;
+        }
+        if ((chunk = malloc(chunk_size)) == NULL)
+        {
+            return NULL;
+        }
+        chunk->size = chunk_size;
+        chunk->used = BENCH_CHUNK_HEADER;
+        if (g_bench_arena_current == NULL)
+        {
+            chunk->next = g_bench_arena_chunks;
+            g_bench_arena_chunks = chunk;
+        }
+        else
+        {
+            chunk->next = g_bench_arena_current->next;
+            g_bench_arena_current->next = chunk;
+        }
+    }
+    g_bench_arena_current = chunk;
+    p = (char*)chunk + chunk->used;
+    chunk->used += block_size;
+    return p;
+}
+
+static void bench_arena_free(void* ptr) { (void)ptr; }
+
+static void bench_arena_reset(void)
+{
+    bench_chunk_t* chunk;
+    for (chunk = g_bench_arena_chunks; chunk != NULL; chunk = chunk->next)
+    {
+        chunk->used = BENCH_CHUNK_HEADER;
+    }
+    g_bench_arena_current = g_bench_arena_chunks;
+}
+
+static void bench_arena_release(void)
+{
+    bench_chunk_t* chunk;
+    while ((chunk = g_bench_arena_chunks) != NULL)
+    {
+        g_bench_arena_chunks = chunk->next;
+        free(chunk);
+    }
+    g_bench_arena_current = NULL;
+}
+
+const bench_alloc_t g_bench_allocs[] = {
+    {"malloc", malloc, free, NULL, bench_alloc_noop},
+    {"pool", bench_pool_malloc, bench_pool_free, NULL, bench_pool_release},
+    {"arena", bench_arena_malloc, bench_arena_free, bench_arena_reset,
+     bench_arena_release},
+};
+const size_t g_bench_allocs_count =
+    sizeof(g_bench_allocs) / sizeof(g_bench_allocs[0]);
@@ -0,0 +1,23 @@
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include "ujson.h"
+#include <stddef.h>
+
+/* Allocators plugged into ujson_allocator_set_malloc/free for the thread
+ * scaling runs; the pooled ones keep their state per thread */
+typedef struct
+{
+    const char* name;
+    ujson_malloc_cb_t malloc_cb;
+    ujson_free_cb_t free_cb;
+    /* Called by a thread after each document, NULL when not needed */
+    void (*reset_cb)(void);
+    /* Called by a thread before it exits to give back its memory */
+    void (*release_cb)(void);
+} bench_alloc_t;
+
+extern const bench_alloc_t g_bench_allocs[];
+extern const size_t g_bench_allocs_count;
+
+#endif
@@ -0,0 +1,226 @@
+#include "bench_corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct bench_buf
+{
+    char* body;
+    size_t size;
+    size_t capacity;
+    unsigned long seed;
+};
+
+static void bench_buf_append(bench_buf_t* buf, const char* s, size_t len)
+{
+    if (buf->size + len + 1 > buf->capacity)
+    {
+        while (buf->size + len + 1 > buf->capacity)
+        {
+            buf->capacity = (buf->capacity == 0) ? 4096 : buf->capacity * 2;
+        }
+        if ((buf->body = realloc(buf->body, buf->capacity)) == NULL)
+        {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(buf->body + buf->size, s, len);
+    buf->size += len;
+    buf->body[buf->size] = '\0';
+}
+
+static void bench_buf_puts(bench_buf_t* buf, const char* s)
+{
+    bench_buf_append(buf, s, strlen(s));
+}
+
+static void bench_buf_put_number(bench_buf_t* buf, unsigned long value)
+{
+    char tmp[32];
+    sprintf(tmp, "%lu", value);
+    bench_buf_puts(buf, tmp);
+}
+
+/* Fixed LCG, so corpora do not depend on the libc rand() */
+static unsigned long bench_buf_rand(bench_buf_t* buf, unsigned long n)
+{
+    buf->seed = (buf->seed * 1103515245ul + 12345ul) & 0x7ffffffful;
+    return (buf->seed >> 8) % n;
+}
+
+static const char* g_bench_words[] = {
+    "alpha", "bravo",  "charlie", "delta", "echo",   "foxtrot", "golf",
+    "hotel", "india",  "juliett", "kilo",  "lima",   "mike",    "november",
+    "oscar", "papa",   "quebec",  "romeo", "sierra", "tango",   "uniform",
+    "victor", "whiskey", "xray",  "yankee", "zulu",
+};
+#define BENCH_WORDS_COUNT (sizeof(g_bench_words) / sizeof(g_bench_words[0]))
+#define BENCH_WORD(buf) (g_bench_words[bench_buf_rand(buf, BENCH_WORDS_COUNT)])
+
+/* Integers, decimals and exponents */
+static void bench_corpus_numbers(bench_buf_t* buf, size_t size)
+{
+    unsigned long kind;
+    bench_buf_puts(buf, "[");
+    while (buf->size < size)
+    {
+        kind = bench_buf_rand(buf, 4);
+        if (kind == 1)
+        {
+            bench_buf_puts(buf, "-");
+        }
+        bench_buf_put_number(buf, bench_buf_rand(buf, 1000000));
+        if (kind >= 2)
+        {
+            bench_buf_puts(buf, ".");
+            bench_buf_put_number(buf, bench_buf_rand(buf, 100000));
+        }
+        if (kind == 3)
+        {
+            bench_buf_puts(buf, "e-");
+            bench_buf_put_number(buf, bench_buf_rand(buf, 30));
+        }
+        bench_buf_puts(buf, ",");
+    }
+    bench_buf_puts(buf, "0]");
+}
+
+/* Sentences with an occasional escape */
+static void bench_corpus_strings(bench_buf_t* buf, size_t size)
+{
+    unsigned long i, count;
+    bench_buf_puts(buf, "[");
+    while (buf->size < size)
+    {
+        bench_buf_puts(buf, "\"");
+        count = 1 + bench_buf_rand(buf, 12);
+        for (i = 0; i != count; i++)
+        {
+            if (i != 0)
+            {
+                bench_buf_puts(buf, (bench_buf_rand(buf, 16) == 0) ? "\\n"
+                                                                   : " ");
+            }
+            bench_buf_puts(buf, BENCH_WORD(buf));
+        }
+        if (bench_buf_rand(buf, 8) == 0)
+        {
+            bench_buf_puts(buf, " \\\"quoted\\\"");
+        }
+        bench_buf_puts(buf, "\",");
+    }
+    bench_buf_puts(buf, "\"\"]");
+}
+
+/* Objects and arrays nested 64 levels deep, side by side */
+static void bench_corpus_deep(bench_buf_t* buf, size_t size)
+{
+    int depth;
+    bench_buf_puts(buf, "[");
+    while (buf->size < size)
+    {
+        for (depth = 0; depth != 64; depth++)
+        {
+            bench_buf_puts(buf, (depth % 2 == 0) ? "{\"child\":" : "[");
+        }
+        bench_buf_puts(buf, "true");
+        for (depth = 63; depth >= 0; depth--)
+        {
+            bench_buf_puts(buf, (depth % 2 == 0) ? "}" : "]");
+        }
+        bench_buf_puts(buf, ",");
+    }
+    bench_buf_puts(buf, "null]");
+}
+
+/* One object with many members */
+static void bench_corpus_wide(bench_buf_t* buf, size_t size)
+{
+    unsigned long i = 0;
+    bench_buf_puts(buf, "{");
+    while (buf->size < size)
+    {
+        bench_buf_puts(buf, "\"");
+        bench_buf_puts(buf, BENCH_WORD(buf));
+        bench_buf_puts(buf, "_");
+        bench_buf_put_number(buf, i++);
+        bench_buf_puts(buf, "\":");
+        bench_buf_put_number(buf, bench_buf_rand(buf, 1000));
+        bench_buf_puts(buf, ",");
+    }
+    bench_buf_puts(buf, "\"last\":null}");
+}
+
+/* Records typical of API responses in one large array */
+static void bench_corpus_array(bench_buf_t* buf, size_t size)
+{
+    unsigned long i = 0;
+    bench_buf_puts(buf, "[");
+    while (buf->size < size)
+    {
+        bench_buf_puts(buf, "{\"id\":");
+        bench_buf_put_number(buf, i++);
+        bench_buf_puts(buf, ",\"name\":\"");
+        bench_buf_puts(buf, BENCH_WORD(buf));
+        bench_buf_puts(buf, "\",\"active\":");
+        bench_buf_puts(buf, (bench_buf_rand(buf, 2) == 0) ? "true" : "false");
+        bench_buf_puts(buf, ",\"score\":");
+        bench_buf_put_number(buf, bench_buf_rand(buf, 100));
+        bench_buf_puts(buf, ".5,\"tags\":[\"");
+        bench_buf_puts(buf, BENCH_WORD(buf));
+        bench_buf_puts(buf, "\",\"");
+        bench_buf_puts(buf, BENCH_WORD(buf));
+        bench_buf_puts(buf, "\"],\"parent\":null},");
+    }
+    bench_buf_puts(buf, "{}]");
+}
+
+/* Multibyte UTF-8 mixed with \u escapes and surrogate pairs */
+static void bench_corpus_unicode(bench_buf_t* buf, size_t size)
+{
+    static const char* pieces[] = {
+        "\xe7\x9f\xa5\xe9\x81\x93",
+        "caf\xc3\xa9",
+        "\xf0\x9f\x98\x80",
+        "\\u00e9t\\u00e9",
+        "\\ud83d\\ude00",
+        "\xd0\xbc\xd0\xb8\xd1\x80",
+        "plain",
+    };
+    const unsigned long pieces_count = sizeof(pieces) / sizeof(pieces[0]);
+    unsigned long i, count;
+    bench_buf_puts(buf, "[");
+    while (buf->size < size)
+    {
+        bench_buf_puts(buf, "\"");
+        count = 1 + bench_buf_rand(buf, 8);
+        for (i = 0; i != count; i++)
+        {
+            bench_buf_puts(buf, pieces[bench_buf_rand(buf, pieces_count)]);
+        }
+        bench_buf_puts(buf, "\",");
+    }
+    bench_buf_puts(buf, "\"\"]");
+}
+
+const bench_corpus_t g_bench_corpora[] = {
+    {"numbers", bench_corpus_numbers}, {"strings", bench_corpus_strings},
+    {"deep", bench_corpus_deep},       {"wide", bench_corpus_wide},
+    {"array", bench_corpus_array},     {"unicode", bench_corpus_unicode},
+};
+const size_t g_bench_corpora_count =
+    sizeof(g_bench_corpora) / sizeof(g_bench_corpora[0]);
+
+char* bench_corpus_generate(const bench_corpus_t* corpus, size_t size,
+                            size_t* len_out)
+{
+    bench_buf_t buf;
+    buf.body = NULL;
+    buf.size = 0;
+    buf.capacity = 0;
+    buf.seed = 20160801ul;
+    corpus->generate(&buf, size);
+    *len_out = buf.size;
+    return buf.body;
+}
@@ -0,0 +1,25 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <stddef.h>
+
+/* Deterministic documents of about size bytes, shaped to stress one part
+ * of the library each; the same name and size always give the same text */
+
+struct bench_buf;
+typedef struct bench_buf bench_buf_t;
+
+typedef struct
+{
+    const char* name;
+    void (*generate)(bench_buf_t* buf, size_t size);
+} bench_corpus_t;
+
+extern const bench_corpus_t g_bench_corpora[];
+extern const size_t g_bench_corpora_count;
+
+/* Returns a malloc'd, NUL-terminated document */
+char* bench_corpus_generate(const bench_corpus_t* corpus, size_t size,
+                            size_t* len_out);
+
+#endif
@@ -0,0 +1,165 @@
+#define _POSIX_C_SOURCE 200112L
+#include "bench_threads.h"
+#include "bench_alloc.h"
+#include "ujson.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    const bench_alloc_t* alloc;
+    pthread_barrier_t* start;
+    char* s;
+    size_t len;
+    int documents;
+    int ret;
+} bench_worker_t;
+
+static void* bench_worker_main(void* data)
+{
+    bench_worker_t* worker = (bench_worker_t*)data;
+    ujson_t* json;
+    char* json_str;
+    ujson_size_t json_str_len;
+    int i;
+
+    pthread_barrier_wait(worker->start);
+    for (i = 0; i != worker->documents; i++)
+    {
+        if ((json = ujson_parse(worker->s, worker->len)) == NULL)
+        {
+            worker->ret = -1;
+            break;
+        }
+        if (ujson_stringify(&json_str, &json_str_len, json) != 0)
+        {
+            ujson_destroy(json);
+            worker->ret = -1;
+            break;
+        }
+        worker->alloc->free_cb(json_str);
+        ujson_destroy(json);
+        if (worker->alloc->reset_cb != NULL)
+        {
+            worker->alloc->reset_cb();
+        }
+    }
+    worker->alloc->release_cb();
+    return NULL;
+}
+
+/* Wall time of threads running documents each, started together */
+static double bench_threads_once(const bench_alloc_t* alloc, char* s,
+                                 size_t len, int threads, int documents)
+{
+    bench_worker_t* workers = malloc(sizeof(bench_worker_t) * (size_t)threads);
+    pthread_t* tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    pthread_barrier_t start;
+    double t0, t1;
+    int i;
+
+    if ((workers == NULL) || (tids == NULL))
+    {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(1);
+    }
+    pthread_barrier_init(&start, NULL, (unsigned int)threads + 1);
+    for (i = 0; i != threads; i++)
+    {
+        workers[i].alloc = alloc;
+        workers[i].start = &start;
+        workers[i].s = s;
+        workers[i].len = len;
+        workers[i].documents = documents;
+        workers[i].ret = 0;
+        if (pthread_create(&tids[i], NULL, bench_worker_main, &workers[i]) !=
+            0)
+        {
+            fprintf(stderr, "bench: can not start thread %d\n", i);
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start);
+    t0 = bench_now_ns();
+    for (i = 0; i != threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    t1 = bench_now_ns();
+    for (i = 0; i != threads; i++)
+    {
+        if (workers[i].ret != 0)
+        {
+            fprintf(stderr, "bench: %s: worker failed\n", alloc->name);
+            exit(1);
+        }
+    }
+    pthread_barrier_destroy(&start);
+    free(tids);
+    free(workers);
+    return t1 - t0;
+}
+
+void bench_threads_run(const bench_options_t* options,
+                       const bench_corpus_t* corpus)
+{
+    size_t len;
+    char* s = bench_corpus_generate(corpus, options->size, &len);
+    const bench_alloc_t* alloc;
+    bench_scaling_result_t result;
+    double base_ns = 0;
+    size_t i;
+    int threads;
+
+    if (s == NULL)
+    {
+        fprintf(stderr, "bench: %s: allocation failed\n", corpus->name);
+        exit(1);
+    }
+    result.corpus = corpus->name;
+    result.bytes = len;
+    for (i = 0; i != g_bench_allocs_count; i++)
+    {
+        alloc = &g_bench_allocs[i];
+        if ((options->allocator != NULL) &&
+            (strcmp(options->allocator, alloc->name) != 0))
+        {
+            continue;
+        }
+        /* The library has one allocator for all threads */
+        ujson_allocator_set_malloc(alloc->malloc_cb);
+        ujson_allocator_set_free(alloc->free_cb);
+        result.allocator = alloc->name;
+        if (options->warmup != 0)
+        {
+            bench_threads_once(alloc, s, len, 1, options->warmup);
+        }
+        threads = 1;
+        for (;;)
+        {
+            result.threads = threads;
+            result.documents = (size_t)threads * (size_t)options->repetitions;
+            result.wall_ns = bench_threads_once(alloc, s, len, threads,
+                                                options->repetitions);
+            if (threads == 1)
+            {
+                base_ns = result.wall_ns;
+            }
+            /* Equal work per thread, so perfect scaling keeps wall time */
+            result.efficiency =
+                (result.wall_ns > 0) ? base_ns / result.wall_ns : 0;
+            bench_report_scaling(stdout, &result);
+            if (threads == options->threads)
+            {
+                break;
+            }
+            threads = (threads * 2 < options->threads) ? threads * 2
+                                                       : options->threads;
+        }
+    }
+    ujson_allocator_set_malloc(malloc);
+    ujson_allocator_set_free(free);
+    free(s);
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_THREADS_H
+#define BENCH_THREADS_H
+
+#include "bench.h"
+#include "bench_corpus.h"
+
+/* Parse, stringify and destroy a corpus on 1, 2, 4 .. options->threads
+ * threads at once under each allocator, reporting how throughput scales */
+void bench_threads_run(const bench_options_t* options,
+                       const bench_corpus_t* corpus);
+
+#endif
@@ -0,0 +1,294 @@
+#include "bench.h"
+#include "bench_corpus.h"
+#include "bench_threads.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Lookups are sampled evenly across the members, since a scan of a very
+ * wide object would otherwise take the whole run */
+#define BENCH_LOOKUPS_MAX 256
+
+typedef struct
+{
+    ujson_t* object;
+    char* key;
+    ujson_size_t len;
+} bench_lookup_t;
+
+typedef struct
+{
+    size_t nodes;
+    bench_lookup_t* lookups;
+    size_t lookups_size;
+    size_t lookups_capacity;
+} bench_walk_t;
+
+/* Count the values of a document and gather every member of every object
+ * for the lookup run */
+static void bench_walk(bench_walk_t* walk, ujson_t* json)
+{
+    ujson_array_item_t* array_item;
+    ujson_object_item_t* object_item;
+    walk->nodes++;
+    if (ujson_type(json) == UJSON_ARRAY)
+    {
+        for (array_item = ujson_as_array_first(json); array_item != NULL;
+             array_item = ujson_as_array_next(array_item))
+        {
+            bench_walk(walk, ujson_as_array_item_value(array_item));
+        }
+    }
+    else if (ujson_type(json) == UJSON_OBJECT)
+    {
+        for (object_item = ujson_as_object_first(json); object_item != NULL;
+             object_item = ujson_as_object_next(object_item))
+        {
+            if (walk->lookups_size == walk->lookups_capacity)
+            {
+                walk->lookups_capacity = (walk->lookups_capacity == 0)
+                                             ? 1024
+                                             : walk->lookups_capacity * 2;
+                walk->lookups =
+                    realloc(walk->lookups,
+                            sizeof(bench_lookup_t) * walk->lookups_capacity);
+                if (walk->lookups == NULL)
+                {
+                    fprintf(stderr, "bench: out of memory\n");
+                    exit(1);
+                }
+            }
+            walk->lookups[walk->lookups_size].object = json;
+            walk->lookups[walk->lookups_size].key =
+                ujson_as_object_item_key_body(object_item);
+            walk->lookups[walk->lookups_size].len =
+                ujson_as_object_item_key_length(object_item);
+            walk->lookups_size++;
+            bench_walk(walk, ujson_as_object_item_value(object_item));
+        }
+    }
+}
+
+static void bench_fail(const char* corpus, const char* what)
+{
+    fprintf(stderr, "bench: %s: %s failed\n", corpus, what);
+    exit(1);
+}
+
+static void bench_corpus_run(const bench_options_t* options,
+                             const bench_corpus_t* corpus)
+{
+    size_t len;
+    char* s = bench_corpus_generate(corpus, options->size, &len);
+    int total = options->warmup + options->repetitions;
+    double* parse_samples = malloc(sizeof(double) * (size_t)total);
+    double* destroy_samples = malloc(sizeof(double) * (size_t)total);
+    double* stringify_samples = malloc(sizeof(double) * (size_t)total);
+    double* lookup_samples = malloc(sizeof(double) * (size_t)total);
+    ujson_t* json;
+    char* json_str;
+    ujson_size_t json_str_len = 0;
+    bench_walk_t walk;
+    bench_result_t result;
+    size_t i, stride;
+    size_t found = 0;
+    int rep;
+    double t0, t1, t2;
+
+    if ((s == NULL) || (parse_samples == NULL) || (destroy_samples == NULL) ||
+        (stringify_samples == NULL) || (lookup_samples == NULL))
+    {
+        bench_fail(corpus->name, "allocation");
+    }
+
+    /* Parse and destroy */
+    for (rep = 0; rep != total; rep++)
+    {
+        t0 = bench_now_ns();
+        if ((json = ujson_parse(s, len)) == NULL)
+        {
+            bench_fail(corpus->name, "parse");
+        }
+        t1 = bench_now_ns();
+        ujson_destroy(json);
+        t2 = bench_now_ns();
+        parse_samples[rep] = t1 - t0;
+        destroy_samples[rep] = t2 - t1;
+    }
+
+    /* Stringify and lookup on one parsed document */
+    if ((json = ujson_parse(s, len)) == NULL)
+    {
+        bench_fail(corpus->name, "parse");
+    }
+    memset(&walk, 0, sizeof(walk));
+    bench_walk(&walk, json);
+    for (rep = 0; rep != total; rep++)
+    {
+        t0 = bench_now_ns();
+        if (ujson_stringify(&json_str, &json_str_len, json) != 0)
+        {
+            bench_fail(corpus->name, "stringify");
+        }
+        t1 = bench_now_ns();
+        free(json_str);
+        stringify_samples[rep] = t1 - t0;
+    }
+    stride = (walk.lookups_size + BENCH_LOOKUPS_MAX - 1) / BENCH_LOOKUPS_MAX;
+    if (stride == 0)
+    {
+        stride = 1;
+    }
+    for (rep = 0; rep != total; rep++)
+    {
+        found = 0;
+        t0 = bench_now_ns();
+        for (i = 0; i < walk.lookups_size; i += stride)
+        {
+            if (ujson_as_object_lookup(walk.lookups[i].object,
+                                       walk.lookups[i].key,
+                                       walk.lookups[i].len) != NULL)
+            {
+                found++;
+            }
+        }
+        t1 = bench_now_ns();
+        if (found != (walk.lookups_size + stride - 1) / stride)
+        {
+            bench_fail(corpus->name, "lookup");
+        }
+        lookup_samples[rep] = t1 - t0;
+    }
+    ujson_destroy(json);
+
+    /* Warmup runs are left out of the figures */
+    result.corpus = corpus->name;
+    result.repetitions = options->repetitions;
+    result.op = "parse";
+    result.bytes = len;
+    result.ops = walk.nodes;
+    bench_samples_summarize(parse_samples + options->warmup,
+                            options->repetitions, &result.best_ns,
+                            &result.median_ns);
+    bench_report_result(stdout, &result);
+    result.op = "stringify";
+    result.bytes = json_str_len;
+    bench_samples_summarize(stringify_samples + options->warmup,
+                            options->repetitions, &result.best_ns,
+                            &result.median_ns);
+    bench_report_result(stdout, &result);
+    result.op = "destroy";
+    result.bytes = len;
+    bench_samples_summarize(destroy_samples + options->warmup,
+                            options->repetitions, &result.best_ns,
+                            &result.median_ns);
+    bench_report_result(stdout, &result);
+    if (walk.lookups_size != 0)
+    {
+        result.op = "lookup";
+        result.bytes = 0;
+        result.ops = found;
+        bench_samples_summarize(lookup_samples + options->warmup,
+                                options->repetitions, &result.best_ns,
+                                &result.median_ns);
+        bench_report_result(stdout, &result);
+    }
+
+    free(walk.lookups);
+    free(parse_samples);
+    free(destroy_samples);
+    free(stringify_samples);
+    free(lookup_samples);
+    free(s);
+}
+
+static void bench_usage(void)
+{
+    fprintf(stderr,
+            "usage: bench [-s size] [-r repetitions] [-w warmup] [-c corpus]\n"
+            "             [-t threads [-a allocator]]\n"
+            "corpora:");
+}
+
+int main(int argc, char* argv[])
+{
+    bench_options_t options;
+    size_t i;
+    int arg;
+
+    options.size = 4 * 1024 * 1024;
+    options.repetitions = 10;
+    options.warmup = 2;
+    options.corpus = NULL;
+    options.threads = 0;
+    options.allocator = NULL;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if ((arg + 1 < argc) && (strcmp(argv[arg], "-s") == 0))
+        {
+            options.size = (size_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if ((arg + 1 < argc) && (strcmp(argv[arg], "-r") == 0))
+        {
+            options.repetitions = atoi(argv[++arg]);
+        }
+        else if ((arg + 1 < argc) && (strcmp(argv[arg], "-w") == 0))
+        {
+            options.warmup = atoi(argv[++arg]);
+        }
+        else if ((arg + 1 < argc) && (strcmp(argv[arg], "-c") == 0))
+        {
+            options.corpus = argv[++arg];
+        }
+        else if ((arg + 1 < argc) && (strcmp(argv[arg], "-t") == 0))
+        {
+            options.threads = atoi(argv[++arg]);
+        }
+        else if ((arg + 1 < argc) && (strcmp(argv[arg], "-a") == 0))
+        {
+            options.allocator = argv[++arg];
+        }
+        else
+        {
+            bench_usage();
+            for (i = 0; i != g_bench_corpora_count; i++)
+            {
+                fprintf(stderr, " %s", g_bench_corpora[i].name);
+            }
+            fprintf(stderr, "\n");
+            return 1;
+        }
+    }
+    if ((options.repetitions < 1) || (options.warmup < 0) ||
+        (options.threads < 0))
+    {
+        bench_usage();
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    ujson_allocator_set_malloc(malloc);
+    ujson_allocator_set_free(free);
+
+    bench_report_begin(stdout, options.size, options.repetitions,
+                       options.warmup);
+    for (i = 0; i != g_bench_corpora_count; i++)
+    {
+        if ((options.corpus == NULL) ||
+            (strcmp(options.corpus, g_bench_corpora[i].name) == 0))
+        {
+            if (options.threads == 0)
+            {
+                bench_corpus_run(&options, &g_bench_corpora[i]);
+            }
+            else
+            {
+                bench_threads_run(&options, &g_bench_corpora[i]);
+            }
+        }
+    }
+    bench_report_end(stdout);
+
+    return 0;
+}
@@ -3,10 +3,53 @@
 
 #include "ujson.h"
 #include <stdio.h>
+#if defined(UJSON_ENABLE_PTHREAD)
+#include <pthread.h>
+#endif
+#if defined(UJSON_ENABLE_SDT)
+#include <sys/sdt.h>
+#endif
 
 /* Constants */
 #define UJSON_MBUF_DEFAULT_INIT_SIZE 512
 #define UJSON_MBUF_DEFAULT_INC_SIZE 512
+/* Character count not known yet, or too large for the 32 bits kept */
+#define UJSON_STRING_CH_LEN_UNKNOWN ((unsigned int)-1)
+/* Longest lexeme a lazily parsed number keeps (raw_len) */
+#define UJSON_NUMBER_RAW_LEN_MAX ((1u << 30) - 1)
+#define UJSON_PARSE_PARALLEL_MIN_CHUNK (64 * 1024)
+#define UJSON_OBJECT_INDEX_THRESHOLD 8
+#define UJSON_FRAGMENT_MIN_SIZE 256
+
+/* Static tracepoints in provider "ujson" for perf, bpftrace or systemtap,
+ * along with the counters only they report. Without UJSON_ENABLE_SDT
+ * both compile to nothing.
+ *
+ *   parse__start(s, len)             parse__done(json, nodes, max_depth)
+ *   parse__array__start(depth, len)  parse__array__done(depth, elements)
+ *   parse__object__start(depth, len) parse__object__done(depth, members)
+ *   stringify__start(json, style)    stringify__done(ret, len, nodes,
+ *                                                    max_depth)
+ *   destroy__start(json, type)       destroy__done()
+ *
+ * len at a container start is the input left from its opening bracket */
+#if defined(UJSON_ENABLE_SDT)
+#define UJSON_SDT(statement)                                                   \
+    do                                                                         \
+    {                                                                          \
+        statement;                                                             \
+    } while (0)
+#define UJSON_PROBE(name) DTRACE_PROBE(ujson, name)
+#define UJSON_PROBE2(name, a, b) DTRACE_PROBE2(ujson, name, a, b)
+#define UJSON_PROBE3(name, a, b, c) DTRACE_PROBE3(ujson, name, a, b, c)
+#define UJSON_PROBE4(name, a, b, c, d) DTRACE_PROBE4(ujson, name, a, b, c, d)
+#else
+#define UJSON_SDT(statement)
+#define UJSON_PROBE(name)
+#define UJSON_PROBE2(name, a, b)
+#define UJSON_PROBE3(name, a, b, c)
+#define UJSON_PROBE4(name, a, b, c, d)
+#endif
 
 struct ujson_array_item
 {
@@ -15,11 +58,20 @@ struct ujson_array_item
     struct ujson_array_item *prev, *next;
 };
 
+/* Output of a container kept by stringify (ujson_stringify_config_t.cache),
+ * len bytes following the header in the same block; small containers keep
+ * none and are written again */
+typedef struct
+{
+    ujson_size_t len;
+} ujson_fragment_t;
+
 struct ujson_array
 {
     ujson_array_item_t *begin, *end;
 
     ujson_size_t size;
+    ujson_fragment_t* fragment;
 };
 
 struct ujson_object_item
@@ -28,35 +80,75 @@ struct ujson_object_item
     {
         char* s;
         ujson_size_t len;
-        unsigned char checksum;
+        unsigned int hash;
+        /* s was allocated on its own; otherwise it follows the item in
+         * the same block or is borrowed from the caller */
+        ujson_bool owned;
     } key;
     struct ujson* value;
 
     struct ujson_object_item *prev, *next;
+    /* Next item in the same bucket of the hash index */
+    struct ujson_object_item* chain;
 };
 
+/* Hash index over the members of an object, a power of two buckets
+ * following the header in the same block */
+typedef struct
+{
+    ujson_size_t size;
+} ujson_object_index_t;
+
 struct ujson_object
 {
-    ujson_object_item_t *begin, *end;
+    /* The prev of begin is the last member */
+    ujson_object_item_t* begin;
+
+    ujson_size_t size;
+    /* Absent until an object is built through ujson_object_set or
+     * reserved */
+    ujson_object_index_t* index;
+    ujson_fragment_t* fragment;
 };
 
 struct ujson
 {
     ujson_type_t type;
+    /* A clean array or object has not changed since it was written with
+     * mode, and neither have its ancestors been changed since */
+    unsigned int clean : 1;
+    unsigned int mode : 2;
+    /* The array or object holding this value */
+    struct ujson* parent;
     union
     {
         ujson_bool part_bool;
         struct
         {
             double as_double;
+            /* Source lexeme of a lazily parsed number, converted into
+             * as_double and as_int on first access */
+            char* raw;
             int as_int;
-            ujson_bool is_double;
+            unsigned int raw_len : 30;
+            unsigned int is_double : 1;
+            unsigned int converted : 1;
         } part_number;
         struct
         {
             char* s;
             ujson_size_t len;
-            ujson_size_t ch_len;
+            unsigned int ch_len;
+            /* s and len are the source span of a lazily parsed string,
+             * still escaped, until it is decoded on first access */
+            unsigned int lazy : 1;
+            unsigned int escaped : 1;
+            /* No byte of s needs escaping, so it is written as is */
+            unsigned int plain : 1;
+            /* s belongs to the caller, and is handed to release (when
+             * set) instead of being freed */
+            unsigned int borrowed : 1;
+            ujson_free_cb_t release;
         } part_string;
         ujson_array_t part_array;
         ujson_object_t part_object;
@@ -72,36 +164,447 @@ struct ujson_mbuf
 };
 typedef struct ujson_mbuf ujson_mbuf_t;
 
+/* Parser */
+typedef struct
+{
+    const ujson_parse_config_t* config;
+#if defined(UJSON_ENABLE_SDT)
+    /* Values built, and the nesting level now and at most */
+    ujson_size_t nodes;
+    ujson_size_t depth;
+    ujson_size_t max_depth;
+#endif
+} ujson_parse_ctx_t;
+
+/* Stringifier */
+typedef struct
+{
+    ujson_mbuf_t* mbuf;
+    const ujson_stringify_config_t* config;
+    /* Stack of sorted member views of the objects being written */
+    ujson_object_item_t** sorted;
+    ujson_size_t sorted_size;
+    ujson_size_t sorted_capacity;
+    /* Decoded lazy strings in canonical output */
+    ujson_mbuf_t scratch;
+    /* Indent style: nesting level, and a newline followed by replacers
+     * for the deepest level seen */
+    ujson_bool pretty;
+    ujson_size_t depth;
+    ujson_mbuf_t indent;
+    /* Containers reuse and keep their output, tagged with the options
+     * it depends on */
+    ujson_bool cache;
+    int cache_mode;
+#if defined(UJSON_ENABLE_SDT)
+    /* Values written, a cached container counting as one */
+    ujson_size_t nodes;
+    ujson_size_t max_depth;
+#endif
+} ujson_stringify_ctx_t;
+
+#if defined(UJSON_ENABLE_SDT)
+static void ujson_sdt_reach(ujson_size_t* max_depth, ujson_size_t depth)
+{
+    if (depth > *max_depth)
+    {
+        *max_depth = depth;
+    }
+}
+#endif
+
 /* Global Staff */
 static ujson_malloc_cb_t g_ujson_malloc = NULL;
 static ujson_free_cb_t g_ujson_free = NULL;
-static ujson_t* ujson_parse_in(char** p, ujson_size_t* len);
+static ujson_t* ujson_parse_in(ujson_parse_ctx_t* ctx, char** p,
+                               ujson_size_t* len);
 
 /* Declarations */
-static int ujson_stringify_value(ujson_mbuf_t* mbuf, const ujson_t* ujson);
+static int ujson_stringify_value(ujson_stringify_ctx_t* ctx,
+                                 const ujson_t* ujson);
+static int ujson_stringify_string_body(ujson_mbuf_t* mbuf, const char* p,
+                                       ujson_size_t len);
 static void ujson_destroy_value(ujson_t* ujson);
+static void ujson_number_convert(ujson_t* ujson);
+static int ujson_string_decode_lazy(ujson_t* ujson);
 
 /* Allocators */
 void ujson_allocator_set_malloc(ujson_malloc_cb_t cb) { g_ujson_malloc = cb; }
 
 void ujson_allocator_set_free(ujson_free_cb_t cb) { g_ujson_free = cb; }
 
+#if defined(UJSON_ENABLE_STATS)
+
+/* Blocks the library frees itself carry their size in front, keeping the
+ * payload aligned, so that free can account for them */
+#define UJSON_STATS_HEADER 16
+
+static ujson_stats_t g_ujson_stats;
+#if defined(UJSON_ENABLE_PTHREAD)
+static pthread_mutex_t g_ujson_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#define UJSON_STATS_LOCK() pthread_mutex_lock(&g_ujson_stats_lock)
+#define UJSON_STATS_UNLOCK() pthread_mutex_unlock(&g_ujson_stats_lock)
+#else
+#define UJSON_STATS_LOCK()
+#define UJSON_STATS_UNLOCK()
+#endif
+#define UJSON_STATS_UPDATE(statement)                                          \
+    do                                                                         \
+    {                                                                          \
+        UJSON_STATS_LOCK();                                                    \
+        statement;                                                             \
+        UJSON_STATS_UNLOCK();                                                  \
+    } while (0)
+
+static void ujson_stats_allocated(ujson_size_t size, ujson_bool retained)
+{
+    UJSON_STATS_LOCK();
+    g_ujson_stats.allocations++;
+    g_ujson_stats.bytes_allocated += size;
+    if (retained == ujson_true)
+    {
+        g_ujson_stats.bytes_in_use += size;
+        if (g_ujson_stats.bytes_in_use > g_ujson_stats.peak_bytes)
+        {
+            g_ujson_stats.peak_bytes = g_ujson_stats.bytes_in_use;
+        }
+    }
+    UJSON_STATS_UNLOCK();
+}
+
+static void* ujson_malloc(ujson_size_t size)
+{
+    char* p = (char*)g_ujson_malloc(UJSON_STATS_HEADER + size);
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    *(ujson_size_t*)p = size;
+    ujson_stats_allocated(size, ujson_true);
+    return p + UJSON_STATS_HEADER;
+}
+
+static void ujson_free(void* ptr)
+{
+    char* p = (char*)ptr - UJSON_STATS_HEADER;
+    ujson_size_t size = *(ujson_size_t*)p;
+    UJSON_STATS_UPDATE(g_ujson_stats.frees++;
+                       g_ujson_stats.bytes_in_use -= size);
+    g_ujson_free(p);
+}
+
+/* Handed to the caller, who frees it with its own free */
+static void* ujson_malloc_out(ujson_size_t size)
+{
+    void* p = g_ujson_malloc(size);
+    if (p != NULL)
+    {
+        ujson_stats_allocated(size, ujson_false);
+    }
+    return p;
+}
+
+void ujson_stats_get(ujson_stats_t* stats)
+{
+    UJSON_STATS_UPDATE(*stats = g_ujson_stats);
+}
+
+void ujson_stats_reset(void)
+{
+    UJSON_STATS_LOCK();
+    g_ujson_stats.allocations = 0;
+    g_ujson_stats.frees = 0;
+    g_ujson_stats.bytes_allocated = 0;
+    g_ujson_stats.peak_bytes = g_ujson_stats.bytes_in_use;
+    g_ujson_stats.mbuf_regrowths = 0;
+    UJSON_STATS_UNLOCK();
+}
+
+#else
+
+#define UJSON_STATS_UPDATE(statement)
+
 static void* ujson_malloc(ujson_size_t size) { return g_ujson_malloc(size); }
 
 static void ujson_free(void* ptr) { g_ujson_free(ptr); }
 
+static void* ujson_malloc_out(ujson_size_t size)
+{
+    return g_ujson_malloc(size);
+}
+
+void ujson_stats_get(ujson_stats_t* stats)
+{
+    static const ujson_stats_t stats_none;
+    *stats = stats_none;
+}
+
+void ujson_stats_reset(void) {}
+
+#endif
+
+/* Node Pools */
+
+typedef enum
+{
+    UJSON_POOL_NODE = 0,
+    UJSON_POOL_ARRAY_ITEM,
+    UJSON_POOL_OBJECT_ITEM,
+    UJSON_POOL_CLASSES,
+} ujson_pool_class_t;
+
+static const ujson_size_t g_ujson_pool_block_size[UJSON_POOL_CLASSES] = {
+    sizeof(ujson_t), sizeof(ujson_array_item_t), sizeof(ujson_object_item_t)};
+
+#if defined(UJSON_ENABLE_POOL)
+
+/* Values and container items are carved out of slabs and recycled through
+ * free lists kept by each thread. A thread holding twice UJSON_POOL_BATCH
+ * free blocks of a class hands a batch over to the shared list, and takes
+ * one back from it before carving a new slab, so blocks freed on another
+ * thread than the one that took them are reused as well. A thread that
+ * exits hands all its free blocks over */
+#define UJSON_POOL_SLAB_BLOCKS 128
+#define UJSON_POOL_BATCH 256
+
+typedef struct ujson_pool_block
+{
+    struct ujson_pool_block* next;
+    /* Next batch on the shared list and the number of blocks in it, kept
+     * in the first block of a batch */
+    struct ujson_pool_block* next_batch;
+    ujson_size_t count;
+} ujson_pool_block_t;
+
+/* Header of a slab, the blocks follow it */
+typedef union ujson_pool_slab
+{
+    union ujson_pool_slab* next;
+    double align;
+} ujson_pool_slab_t;
+
+typedef struct
+{
+    ujson_pool_block_t* free_list;
+    ujson_size_t count;
+} ujson_pool_t;
+
+#if defined(UJSON_ENABLE_PTHREAD)
+#define UJSON_THREAD_LOCAL __thread
+static pthread_mutex_t g_ujson_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define UJSON_POOL_LOCK() pthread_mutex_lock(&g_ujson_pool_lock)
+#define UJSON_POOL_UNLOCK() pthread_mutex_unlock(&g_ujson_pool_lock)
+#else
+#define UJSON_THREAD_LOCAL
+#define UJSON_POOL_LOCK()
+#define UJSON_POOL_UNLOCK()
+#endif
+
+static UJSON_THREAD_LOCAL ujson_pool_t g_ujson_pools[UJSON_POOL_CLASSES];
+/* Free lists left from before the last ujson_pool_release are dropped */
+static UJSON_THREAD_LOCAL unsigned int g_ujson_pools_generation;
+static unsigned int g_ujson_pool_generation;
+/* Shared between threads, under the lock */
+static ujson_pool_block_t* g_ujson_pool_batches[UJSON_POOL_CLASSES];
+static ujson_pool_slab_t* g_ujson_pool_slabs;
+
+static void ujson_pool_share(ujson_pool_class_t cls, ujson_pool_block_t* batch,
+                             ujson_size_t count)
+{
+    batch->count = count;
+    UJSON_POOL_LOCK();
+    batch->next_batch = g_ujson_pool_batches[cls];
+    g_ujson_pool_batches[cls] = batch;
+    UJSON_POOL_UNLOCK();
+}
+
+#if defined(UJSON_ENABLE_PTHREAD)
+
+static pthread_key_t g_ujson_pool_key;
+static pthread_once_t g_ujson_pool_key_once = PTHREAD_ONCE_INIT;
+static UJSON_THREAD_LOCAL ujson_bool g_ujson_pools_registered;
+
+/* Key destructor: the free lists of an exiting thread, slab remainder
+ * included, would otherwise be lost with it */
+static void ujson_pool_thread_exit(void* data)
+{
+    int i;
+    (void)data;
+    if (g_ujson_pools_generation != g_ujson_pool_generation)
+    {
+        return;
+    }
+    for (i = 0; i != UJSON_POOL_CLASSES; i++)
+    {
+        if (g_ujson_pools[i].free_list != NULL)
+        {
+            ujson_pool_share((ujson_pool_class_t)i, g_ujson_pools[i].free_list,
+                             g_ujson_pools[i].count);
+            g_ujson_pools[i].free_list = NULL;
+            g_ujson_pools[i].count = 0;
+        }
+    }
+}
+
+static void ujson_pool_key_create(void)
+{
+    pthread_key_create(&g_ujson_pool_key, ujson_pool_thread_exit);
+}
+
+#endif
+
+static ujson_pool_t* ujson_pool_of(ujson_pool_class_t cls)
+{
+    int i;
+#if defined(UJSON_ENABLE_PTHREAD)
+    if (g_ujson_pools_registered == ujson_false)
+    {
+        /* Any non-NULL value has the destructor run at thread exit */
+        pthread_once(&g_ujson_pool_key_once, ujson_pool_key_create);
+        pthread_setspecific(g_ujson_pool_key, g_ujson_pools);
+        g_ujson_pools_registered = ujson_true;
+    }
+#endif
+    if (g_ujson_pools_generation != g_ujson_pool_generation)
+    {
+        for (i = 0; i != UJSON_POOL_CLASSES; i++)
+        {
+            g_ujson_pools[i].free_list = NULL;
+            g_ujson_pools[i].count = 0;
+        }
+        g_ujson_pools_generation = g_ujson_pool_generation;
+    }
+    return &g_ujson_pools[cls];
+}
+
+/* Fill an empty free list with a shared batch or a new slab */
+static int ujson_pool_refill(ujson_pool_t* pool, ujson_pool_class_t cls)
+{
+    ujson_size_t size = g_ujson_pool_block_size[cls];
+    ujson_pool_slab_t* slab;
+    ujson_pool_block_t* block;
+    ujson_size_t i;
+
+    UJSON_POOL_LOCK();
+    if ((block = g_ujson_pool_batches[cls]) != NULL)
+    {
+        g_ujson_pool_batches[cls] = block->next_batch;
+        UJSON_POOL_UNLOCK();
+        pool->free_list = block;
+        pool->count = block->count;
+        return 0;
+    }
+    UJSON_POOL_UNLOCK();
+
+    if ((slab = (ujson_pool_slab_t*)ujson_malloc(
+             sizeof(ujson_pool_slab_t) + size * UJSON_POOL_SLAB_BLOCKS)) ==
+        NULL)
+    {
+        return -1;
+    }
+    UJSON_POOL_LOCK();
+    slab->next = g_ujson_pool_slabs;
+    g_ujson_pool_slabs = slab;
+    UJSON_POOL_UNLOCK();
+    /* Hand the blocks out in address order */
+    for (i = UJSON_POOL_SLAB_BLOCKS; i != 0; i--)
+    {
+        block = (ujson_pool_block_t*)((char*)(slab + 1) + size * (i - 1));
+        block->next = pool->free_list;
+        pool->free_list = block;
+    }
+    pool->count = UJSON_POOL_SLAB_BLOCKS;
+    return 0;
+}
+
+static void* ujson_pool_alloc(ujson_pool_class_t cls)
+{
+    ujson_pool_t* pool = ujson_pool_of(cls);
+    ujson_pool_block_t* block;
+    if ((pool->free_list == NULL) && (ujson_pool_refill(pool, cls) != 0))
+    {
+        return NULL;
+    }
+    block = pool->free_list;
+    pool->free_list = block->next;
+    pool->count--;
+    return block;
+}
+
+static void ujson_pool_free(ujson_pool_class_t cls, void* ptr)
+{
+    ujson_pool_t* pool = ujson_pool_of(cls);
+    ujson_pool_block_t* batch = (ujson_pool_block_t*)ptr;
+    ujson_pool_block_t* last;
+    ujson_size_t i;
+
+    batch->next = pool->free_list;
+    pool->free_list = batch;
+    if (++pool->count < UJSON_POOL_BATCH * 2)
+    {
+        return;
+    }
+    /* Hand the most recently freed batch over */
+    last = batch;
+    for (i = 1; i != UJSON_POOL_BATCH; i++)
+    {
+        last = last->next;
+    }
+    pool->free_list = last->next;
+    pool->count -= UJSON_POOL_BATCH;
+    last->next = NULL;
+    ujson_pool_share(cls, batch, UJSON_POOL_BATCH);
+}
+
+void ujson_pool_release(void)
+{
+    ujson_pool_slab_t* slab;
+    int i;
+    UJSON_POOL_LOCK();
+    while ((slab = g_ujson_pool_slabs) != NULL)
+    {
+        g_ujson_pool_slabs = slab->next;
+        ujson_free(slab);
+    }
+    for (i = 0; i != UJSON_POOL_CLASSES; i++)
+    {
+        g_ujson_pool_batches[i] = NULL;
+    }
+    g_ujson_pool_generation++;
+    UJSON_POOL_UNLOCK();
+}
+
+#else
+
+static void* ujson_pool_alloc(ujson_pool_class_t cls)
+{
+    return ujson_malloc(g_ujson_pool_block_size[cls]);
+}
+
+static void ujson_pool_free(ujson_pool_class_t cls, void* ptr)
+{
+    (void)cls;
+    ujson_free(ptr);
+}
+
+void ujson_pool_release(void) {}
+
+#endif
+
 /* Mutable Buffer */
 
-static unsigned char ujson_checksum(char* buf, ujson_size_t len)
+/* FNV-1a, used to tell object keys apart before comparing bytes */
+static unsigned int ujson_hash(const char* buf, ujson_size_t len)
 {
-    unsigned char checksum = 0;
+    unsigned int hash = 2166136261u;
 
     while (len-- != 0)
     {
-        checksum += *buf++;
+        hash ^= (unsigned char)*buf++;
+        hash *= 16777619u;
     }
 
-    return checksum;
+    return hash;
 }
 
 static void* ujson_memcpy(void* dest, const void* src, ujson_size_t n)
@@ -115,6 +618,33 @@ static void* ujson_memcpy(void* dest, const void* src, ujson_size_t n)
     return dest;
 }
 
+/* Decoded strings and keys may hold '\0', so they compare as bytes */
+static int ujson_memcmp(const void* s1, const void* s2, ujson_size_t n)
+{
+    const unsigned char* p1 = s1;
+    const unsigned char* p2 = s2;
+    while (n-- != 0)
+    {
+        if (*p1 != *p2)
+        {
+            return *p1 - *p2;
+        }
+        p1++;
+        p2++;
+    }
+    return 0;
+}
+
+static ujson_size_t ujson_strlen(const char* s)
+{
+    const char* p = s;
+    while (*p != '\0')
+    {
+        p++;
+    }
+    return (ujson_size_t)(p - s);
+}
+
 static int ujson_strncmp(const char* s1, const char* s2, ujson_size_t n)
 {
     const char *p1 = s1, *p2 = s2;
@@ -143,7 +673,7 @@ static int ujson_mbuf_init(ujson_mbuf_t* mbuf)
 {
     mbuf->size = 0;
     mbuf->capacity = UJSON_MBUF_DEFAULT_INIT_SIZE;
-    if ((mbuf->body = (char*)g_ujson_malloc(
+    if ((mbuf->body = (char*)ujson_malloc(
              sizeof(char) * UJSON_MBUF_DEFAULT_INIT_SIZE)) == ((void*)0))
     {
         return -1;
@@ -155,37 +685,47 @@ static void ujson_mbuf_uninit(ujson_mbuf_t* mbuf)
 {
     if (mbuf->body != (void*)0)
     {
-        g_ujson_free(mbuf->body);
+        ujson_free(mbuf->body);
         mbuf->body = (void*)0;
     }
 }
 
-static int ujson_mbuf_append(ujson_mbuf_t* mbuf, const char* s,
-                             const ujson_size_t len)
+/* Make room for len more bytes and the terminator */
+static int ujson_mbuf_reserve(ujson_mbuf_t* mbuf, const ujson_size_t len)
 {
     char* new_buf = (void*)0;
     ujson_size_t new_capacity;
-    if (mbuf->size + len + 1 >= mbuf->capacity)
+    if (mbuf->size + len + 1 < mbuf->capacity)
+    {
+        return 0;
+    }
+    /* Extend geometrically so that appending stays linear overall */
+    new_capacity = mbuf->capacity * 2;
+    if (new_capacity < mbuf->size + len + 1 + UJSON_MBUF_DEFAULT_INC_SIZE)
     {
-        /* Extend */
         new_capacity = mbuf->size + len + 1 + UJSON_MBUF_DEFAULT_INC_SIZE;
-        new_buf = (char*)g_ujson_malloc(sizeof(char) * new_capacity);
-        if (new_buf == (void*)0)
-            return -1;
-        ujson_memcpy(new_buf, mbuf->body, mbuf->size);
-        ujson_memcpy(new_buf + mbuf->size, s, len);
-        mbuf->size = mbuf->size + len;
-        new_buf[mbuf->size] = '\0';
-        mbuf->capacity = new_capacity;
-        g_ujson_free(mbuf->body);
-        mbuf->body = new_buf;
     }
-    else
+    new_buf = (char*)ujson_malloc(sizeof(char) * new_capacity);
+    if (new_buf == (void*)0)
+        return -1;
+    UJSON_STATS_UPDATE(g_ujson_stats.mbuf_regrowths++);
+    ujson_memcpy(new_buf, mbuf->body, mbuf->size);
+    mbuf->capacity = new_capacity;
+    ujson_free(mbuf->body);
+    mbuf->body = new_buf;
+    return 0;
+}
+
+static int ujson_mbuf_append(ujson_mbuf_t* mbuf, const char* s,
+                             const ujson_size_t len)
+{
+    if (ujson_mbuf_reserve(mbuf, len) != 0)
     {
-        ujson_memcpy(mbuf->body + mbuf->size, s, len);
-        mbuf->size += len;
-        mbuf->body[mbuf->size] = '\0';
+        return -1;
     }
+    ujson_memcpy(mbuf->body + mbuf->size, s, len);
+    mbuf->size += len;
+    mbuf->body[mbuf->size] = '\0';
     return 0;
 }
 
@@ -199,7 +739,7 @@ static int ujson_mbuf_extract(char** json_str, ujson_size_t* json_str_len,
     char* new_str = NULL;
     ujson_size_t len = ujson_mbuf_size(mbuf);
 
-    if ((new_str = ujson_malloc(len + 1)) == NULL)
+    if ((new_str = ujson_malloc_out(len + 1)) == NULL)
     {
         return -1;
     }
@@ -210,30 +750,81 @@ static int ujson_mbuf_extract(char** json_str, ujson_size_t* json_str_len,
     return 0;
 }
 
+static ujson_fragment_t** ujson_fragment_of(ujson_t* ujson)
+{
+    return (ujson->type == UJSON_ARRAY) ? &ujson->u.part_array.fragment
+                                        : &ujson->u.part_object.fragment;
+}
+
+static char* ujson_fragment_body(ujson_fragment_t* fragment)
+{
+    return (char*)(fragment + 1);
+}
+
+static void ujson_fragment_free(ujson_t* ujson)
+{
+    ujson_fragment_t** fragment = ujson_fragment_of(ujson);
+    if (*fragment != NULL)
+    {
+        ujson_free(*fragment);
+        *fragment = NULL;
+    }
+}
+
+/* A change under a container makes it and its ancestors write themselves
+ * again; ancestors of a container that is not clean are not clean either */
+static void ujson_fragment_invalidate(ujson_t* ujson)
+{
+    while ((ujson != NULL) && (ujson->clean != 0))
+    {
+        ujson->clean = 0;
+        ujson_fragment_free(ujson);
+        ujson = ujson->parent;
+    }
+}
+
+static void ujson_object_init(ujson_object_t* object)
+{
+    object->begin = NULL;
+    object->size = 0;
+    object->index = NULL;
+    object->fragment = NULL;
+}
+
 static ujson_t* ujson_new(ujson_type_t type)
 {
-    ujson_t* new_json = ujson_malloc(sizeof(ujson_t));
+    ujson_t* new_json = (ujson_t*)ujson_pool_alloc(UJSON_POOL_NODE);
     if (new_json == NULL)
         return NULL;
     new_json->type = type;
+    new_json->clean = 0;
+    new_json->mode = 0;
+    new_json->parent = NULL;
+    UJSON_STATS_UPDATE(g_ujson_stats.nodes[type]++);
     switch (type)
     {
     case UJSON_BOOL:
     case UJSON_NULL:
     case UJSON_UNDEFINED:
+        break;
     case UJSON_NUMEBR:
+        new_json->u.part_number.raw = NULL;
         break;
     case UJSON_STRING:
         new_json->u.part_string.s = NULL;
+        new_json->u.part_string.lazy = 0;
+        new_json->u.part_string.escaped = 0;
+        new_json->u.part_string.plain = 0;
+        new_json->u.part_string.borrowed = 0;
         break;
     case UJSON_ARRAY:
         new_json->u.part_array.begin = NULL;
         new_json->u.part_array.end = NULL;
         new_json->u.part_array.size = 0;
+        new_json->u.part_array.fragment = NULL;
         break;
     case UJSON_OBJECT:
-        new_json->u.part_object.begin = NULL;
-        new_json->u.part_object.end = NULL;
+        ujson_object_init(&new_json->u.part_object);
         break;
     }
     return new_json;
@@ -259,13 +850,25 @@ ujson_t* ujson_new_number(int value, double value_double)
     return new_ujson;
 }
 
+/* A count that does not fit is counted again when asked for */
+static void ujson_string_ch_len_set(ujson_t* ujson, ujson_size_t ch_len)
+{
+    ujson->u.part_string.ch_len =
+        (ch_len < (ujson_size_t)UJSON_STRING_CH_LEN_UNKNOWN)
+            ? (unsigned int)ch_len
+            : UJSON_STRING_CH_LEN_UNKNOWN;
+}
+
 static ujson_t* ujson_new_string2(char* s, ujson_size_t len,
                                   ujson_size_t ch_len)
 {
     ujson_t* new_ujson;
-    new_ujson = ujson_new(UJSON_STRING);
+    if ((new_ujson = ujson_new(UJSON_STRING)) == NULL)
+    {
+        return NULL;
+    }
     new_ujson->u.part_string.len = len;
-    new_ujson->u.part_string.ch_len = ch_len;
+    ujson_string_ch_len_set(new_ujson, ch_len);
     if (len == 0)
     {
         new_ujson->u.part_string.s = NULL;
@@ -322,6 +925,129 @@ typedef enum
 
 #define IS_HYPER_ID(ch) (((ch)&128) != 0 ? 1 : 0)
 
+/* First byte classes, which decide the kind of a value */
+typedef enum
+{
+    UJSON_CHAR_OTHER = 0,
+    UJSON_CHAR_WS,
+    UJSON_CHAR_NUMBER,
+    UJSON_CHAR_STRING,
+    UJSON_CHAR_ARRAY,
+    UJSON_CHAR_OBJECT,
+    UJSON_CHAR_NULL,
+    UJSON_CHAR_TRUE,
+    UJSON_CHAR_FALSE,
+    UJSON_CHAR_UNDEFINED,
+} ujson_char_class_t;
+
+#define XX UJSON_CHAR_OTHER
+#define WS UJSON_CHAR_WS
+#define NM UJSON_CHAR_NUMBER
+#define ST UJSON_CHAR_STRING
+#define AR UJSON_CHAR_ARRAY
+#define OB UJSON_CHAR_OBJECT
+#define NU UJSON_CHAR_NULL
+#define TR UJSON_CHAR_TRUE
+#define FA UJSON_CHAR_FALSE
+#define UN UJSON_CHAR_UNDEFINED
+static const unsigned char g_ujson_char_class[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, WS, WS, XX, XX, WS, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    WS, XX, ST, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, NM, XX, XX,
+    NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, AR, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, FA, XX, XX, XX, XX, XX, XX, XX, NU, XX,
+    XX, XX, XX, XX, TR, UN, XX, XX, XX, XX, XX, OB, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+#undef XX
+#undef WS
+#undef NM
+#undef ST
+#undef AR
+#undef OB
+#undef NU
+#undef TR
+#undef FA
+#undef UN
+
+#define UJSON_CHAR_CLASS(ch) (g_ujson_char_class[(unsigned char)(ch)])
+
+/* Literals are compared a word at a time; compilers turn the byte
+ * assembly into a single load */
+#define UJSON_WORD(a, b, c, d)                                                 \
+    (((unsigned long)(unsigned char)(a)) |                                     \
+     ((unsigned long)(unsigned char)(b) << 8) |                                \
+     ((unsigned long)(unsigned char)(c) << 16) |                               \
+     ((unsigned long)(unsigned char)(d) << 24))
+
+static unsigned long ujson_load_word(const char* p)
+{
+    return UJSON_WORD(p[0], p[1], p[2], p[3]);
+}
+
+/* Length of the literal of a class at p, 0 if it does not match */
+static ujson_size_t ujson_match_literal(const char* p, ujson_size_t len,
+                                        unsigned char char_class)
+{
+    ujson_size_t literal_len;
+    if (len < 4)
+    {
+        return 0;
+    }
+    switch (char_class)
+    {
+    case UJSON_CHAR_NULL:
+        if (ujson_load_word(p) != UJSON_WORD('n', 'u', 'l', 'l'))
+        {
+            return 0;
+        }
+        literal_len = 4;
+        break;
+    case UJSON_CHAR_TRUE:
+        if (ujson_load_word(p) != UJSON_WORD('t', 'r', 'u', 'e'))
+        {
+            return 0;
+        }
+        literal_len = 4;
+        break;
+    case UJSON_CHAR_FALSE:
+        if ((len < 5) ||
+            (ujson_load_word(p) != UJSON_WORD('f', 'a', 'l', 's')) ||
+            (p[4] != 'e'))
+        {
+            return 0;
+        }
+        literal_len = 5;
+        break;
+    case UJSON_CHAR_UNDEFINED:
+        if ((len < 9) ||
+            (ujson_load_word(p) != UJSON_WORD('u', 'n', 'd', 'e')) ||
+            (ujson_load_word(p + 4) != UJSON_WORD('f', 'i', 'n', 'e')) ||
+            (p[8] != 'd'))
+        {
+            return 0;
+        }
+        literal_len = 9;
+        break;
+    default:
+        return 0;
+    }
+    if ((len > literal_len) && (ISID(p[literal_len])))
+    {
+        return 0;
+    }
+    return literal_len;
+}
+
 static int ujson_parse_in_string_hexchar_to_num(char ch)
 {
     int result;
@@ -331,11 +1057,11 @@ static int ujson_parse_in_string_hexchar_to_num(char ch)
     }
     else if (('a' <= ch) && (ch <= 'f'))
     {
-        result = (int)ch - (int)'a';
+        result = (int)ch - (int)'a' + 10;
     }
     else if (('A' <= ch) && (ch <= 'F'))
     {
-        result = (int)ch - (int)'A';
+        result = (int)ch - (int)'A' + 10;
     }
     else
         result = -1;
@@ -396,18 +1122,20 @@ static ujson_size_t id_hyper_length(char ch)
     return bytes_number;
 }
 
-ujson_t* ujson_new_string(char* s, ujson_size_t len)
+/* Decode an escaped string body into buffer, stopping at '"' or the end;
+ * plain_out (if given) tells whether the result can be written unescaped */
+static int ujson_string_decode(char** p_io, ujson_size_t* len_io,
+                               ujson_mbuf_t* buffer, ujson_size_t* ch_len_out,
+                               ujson_bool* plain_out)
 {
-    char* p = s;
-    ujson_t* new_str = NULL;
-    ujson_mbuf_t buffer;
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
     ujson_parse_in_string_state_t state = UJSON_PARSE_IN_STRING_STATE_INIT;
     ujson_size_t bytes_number;
     ujson_size_t ch_len = 0;
+    ujson_bool plain = ujson_true;
     int value_u;
     char writebuf[7];
-    /* Initialize buffer */
-    ujson_mbuf_init(&buffer);
     while (len > 0)
     {
         switch (state)
@@ -421,22 +1149,23 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             {
                 if ((len < 2))
                 {
-                    goto fail;
+                    return -1;
                 }
                 state = UJSON_PARSE_IN_STRING_STATE_ESCAPE;
+                plain = ujson_false;
                 p++;
                 len--;
             }
             else if (IS_HYPER_ID(*p))
             {
                 bytes_number = id_hyper_length(*p);
-                if (len < bytes_number)
+                if ((bytes_number == 0) || (len < bytes_number))
                 {
-                    goto fail;
+                    return -1;
                 }
-                if (ujson_mbuf_append(&buffer, p, bytes_number) != 0)
+                if (ujson_mbuf_append(buffer, p, bytes_number) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p += bytes_number;
@@ -444,21 +1173,25 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else
             {
-                if (ujson_mbuf_append(&buffer, p, 1) != 0)
+                if ((*p == '/') || ((unsigned char)*p < 0x20))
                 {
-                    goto fail;
+                    plain = ujson_false;
                 }
-                ch_len++;
-                p++;
+                if (ujson_mbuf_append(buffer, p, 1) != 0)
+                {
+                    return -1;
+                }
+                ch_len++;
+                p++;
                 len--;
             }
             break;
         case UJSON_PARSE_IN_STRING_STATE_ESCAPE:
             if (*p == '"')
             {
-                if (ujson_mbuf_append(&buffer, "\"", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\"", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -466,9 +1199,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == '\\')
             {
-                if (ujson_mbuf_append(&buffer, "\\", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\\", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -476,9 +1209,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == '/')
             {
-                if (ujson_mbuf_append(&buffer, "/", 1) != 0)
+                if (ujson_mbuf_append(buffer, "/", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -486,9 +1219,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == 'b')
             {
-                if (ujson_mbuf_append(&buffer, "\b", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\b", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -496,9 +1229,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == 'f')
             {
-                if (ujson_mbuf_append(&buffer, "\f", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\f", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -506,9 +1239,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == 'n')
             {
-                if (ujson_mbuf_append(&buffer, "\n", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\n", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -516,9 +1249,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == 'r')
             {
-                if (ujson_mbuf_append(&buffer, "\r", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\r", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -526,9 +1259,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             }
             else if (*p == 't')
             {
-                if (ujson_mbuf_append(&buffer, "\t", 1) != 0)
+                if (ujson_mbuf_append(buffer, "\t", 1) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
                 ch_len++;
                 p++;
@@ -538,13 +1271,13 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
             {
                 value_u = ujson_parse_in_string_hexchar_to_num_s4(p + 1);
                 if (value_u == -1)
-                    goto fail;
+                    return -1;
                 if ((0 <= value_u) && (value_u <= 0x7F))
                 {
                     writebuf[0] = ((char)value_u);
-                    if (ujson_mbuf_append(&buffer, writebuf, 1) != 0)
+                    if (ujson_mbuf_append(buffer, writebuf, 1) != 0)
                     {
-                        goto fail;
+                        return -1;
                     }
                     ch_len++;
                     p += 5;
@@ -555,15 +1288,15 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
                     writebuf[0] = (char)(0xc0 | (((unsigned int)value_u) >> 6));
                     writebuf[1] =
                         (char)(0x80 | (((unsigned int)value_u) & 0x3f));
-                    if (ujson_mbuf_append(&buffer, writebuf, 2) != 0)
+                    if (ujson_mbuf_append(buffer, writebuf, 2) != 0)
                     {
-                        goto fail;
+                        return -1;
                     }
                     ch_len++;
                     p += 5;
                     len -= 5;
                 }
-                else if ((0x800 <= value_u) && (value_u <= 0x7FFF))
+                else if ((0x800 <= value_u) && (value_u <= 0xFFFF))
                 {
                     writebuf[0] =
                         (char)(0xe0 | (((unsigned int)value_u) >> 12));
@@ -571,9 +1304,9 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
                         (char)(0x80 | (((unsigned int)value_u >> 6) & 0x3f));
                     writebuf[2] =
                         (char)(0x80 | (((unsigned int)value_u) & 0x3f));
-                    if (ujson_mbuf_append(&buffer, writebuf, 3) != 0)
+                    if (ujson_mbuf_append(buffer, writebuf, 3) != 0)
                     {
-                        goto fail;
+                        return -1;
                     }
                     ch_len++;
                     p += 5;
@@ -581,12 +1314,12 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
                 }
                 else
                 {
-                    goto fail;
+                    return -1;
                 }
             }
             else
             {
-                goto fail;
+                return -1;
             }
             /* Reset state */
             state = UJSON_PARSE_IN_STRING_STATE_INIT;
@@ -594,13 +1327,57 @@ ujson_t* ujson_new_string(char* s, ujson_size_t len)
         }
     }
 finish:
-    new_str = ujson_new_string2(ujson_mbuf_body(&buffer),
-                                ujson_mbuf_size(&buffer), ch_len);
+    *p_io = p;
+    *len_io = len;
+    *ch_len_out = ch_len;
+    if (plain_out != NULL)
+    {
+        *plain_out = plain;
+    }
+    return 0;
+}
+
+ujson_t* ujson_new_string(char* s, ujson_size_t len)
+{
+    ujson_t* new_str = NULL;
+    ujson_mbuf_t buffer;
+    ujson_size_t ch_len;
+    ujson_bool plain;
+    /* Initialize buffer */
+    if (ujson_mbuf_init(&buffer) != 0)
+    {
+        return NULL;
+    }
+    if ((ujson_string_decode(&s, &len, &buffer, &ch_len, &plain) == 0) &&
+        ((new_str = ujson_new_string2(ujson_mbuf_body(&buffer),
+                                      ujson_mbuf_size(&buffer), ch_len)) !=
+         NULL))
+    {
+        new_str->u.part_string.plain = plain;
+    }
     ujson_mbuf_uninit(&buffer);
     return new_str;
-fail:
-    ujson_mbuf_uninit(&buffer);
-    return NULL;
+}
+
+ujson_t* ujson_new_string_raw(const char* s, ujson_size_t len)
+{
+    return ujson_new_string2((char*)s, len, UJSON_STRING_CH_LEN_UNKNOWN);
+}
+
+ujson_t* ujson_new_string_ref(char* s, ujson_size_t len,
+                              ujson_free_cb_t release)
+{
+    ujson_t* new_ujson;
+    if ((new_ujson = ujson_new(UJSON_STRING)) == NULL)
+    {
+        return NULL;
+    }
+    new_ujson->u.part_string.s = s;
+    new_ujson->u.part_string.len = len;
+    new_ujson->u.part_string.ch_len = UJSON_STRING_CH_LEN_UNKNOWN;
+    new_ujson->u.part_string.borrowed = ujson_true;
+    new_ujson->u.part_string.release = release;
+    return new_ujson;
 }
 
 ujson_t* ujson_new_bool(ujson_bool value)
@@ -619,7 +1396,8 @@ ujson_t* ujson_new_undefined(void) { return ujson_new(UJSON_UNDEFINED); }
 
 ujson_array_item_t* ujson_array_item_new(ujson_t* element)
 {
-    ujson_array_item_t* new_item = ujson_malloc(sizeof(ujson_array_item_t));
+    ujson_array_item_t* new_item =
+        (ujson_array_item_t*)ujson_pool_alloc(UJSON_POOL_ARRAY_ITEM);
     if (new_item == NULL)
         return NULL;
     new_item->next = new_item->prev = NULL;
@@ -633,7 +1411,7 @@ void ujson_array_item_destroy(ujson_array_item_t* item)
     {
         ujson_destroy_value(item->value);
     }
-    ujson_free(item);
+    ujson_pool_free(UJSON_POOL_ARRAY_ITEM, item);
 }
 
 ujson_t* ujson_new_array(void)
@@ -650,6 +1428,11 @@ ujson_t* ujson_new_array(void)
 
 int ujson_array_push_back(ujson_t* array, ujson_array_item_t* new_item)
 {
+    if (new_item->value != NULL)
+    {
+        new_item->value->parent = array;
+    }
+    ujson_fragment_invalidate(array);
     if (array->u.part_array.begin == NULL)
     {
         array->u.part_array.begin = new_item;
@@ -667,30 +1450,48 @@ int ujson_array_push_back(ujson_t* array, ujson_array_item_t* new_item)
 
 ujson_object_item_t* ujson_object_item_new(ujson_t* key, ujson_t* value)
 {
-    ujson_object_item_t* new_item = ujson_malloc(sizeof(ujson_object_item_t));
+    ujson_object_item_t* new_item =
+        (ujson_object_item_t*)ujson_pool_alloc(UJSON_POOL_OBJECT_ITEM);
     if (new_item == NULL)
         return NULL;
     new_item->next = new_item->prev = NULL;
+    new_item->chain = NULL;
     /* Key */
+    if ((key->u.part_string.lazy != 0) &&
+        (ujson_string_decode_lazy(key) != 0))
+    {
+        ujson_pool_free(UJSON_POOL_OBJECT_ITEM, new_item);
+        return NULL;
+    }
     new_item->key.len = key->u.part_string.len;
     if ((new_item->key.s = (char*)ujson_malloc(
              sizeof(char) * (new_item->key.len + 1))) == NULL)
     {
-        ujson_free(new_item);
+        ujson_pool_free(UJSON_POOL_OBJECT_ITEM, new_item);
         return NULL;
     }
     ujson_memcpy(new_item->key.s, key->u.part_string.s, new_item->key.len);
     new_item->key.s[new_item->key.len] = '\0';
+    new_item->key.owned = ujson_true;
     ujson_destroy_value(key);
-    new_item->key.checksum = ujson_checksum(new_item->key.s, new_item->key.len);
+    new_item->key.hash = ujson_hash(new_item->key.s, new_item->key.len);
     /* Value */
     new_item->value = value;
     return new_item;
 }
 
+/* The key was copied into the same block, right after the item */
+static ujson_bool ujson_object_item_key_inline(const ujson_object_item_t* item)
+{
+    return ((item->key.owned == ujson_false) &&
+            (item->key.s == (const char*)(item + 1)))
+               ? ujson_true
+               : ujson_false;
+}
+
 void ujson_object_item_destroy(ujson_object_item_t* item)
 {
-    if (item->key.s != NULL)
+    if (item->key.owned == ujson_true)
     {
         ujson_free(item->key.s);
     }
@@ -698,59 +1499,371 @@ void ujson_object_item_destroy(ujson_object_item_t* item)
     {
         ujson_destroy_value(item->value);
     }
-    ujson_free(item);
+    if (ujson_object_item_key_inline(item) == ujson_true)
+    {
+        ujson_free(item);
+    }
+    else
+    {
+        ujson_pool_free(UJSON_POOL_OBJECT_ITEM, item);
+    }
 }
 
 ujson_t* ujson_new_object(void)
 {
     ujson_t* new_ujson;
     new_ujson = ujson_new(UJSON_OBJECT);
-    new_ujson->u.part_object.begin = NULL;
-    new_ujson->u.part_object.end = NULL;
     return new_ujson;
 }
 
+static ujson_object_item_t** ujson_object_bucket(ujson_object_index_t* index,
+                                                 unsigned int hash)
+{
+    return (ujson_object_item_t**)(index + 1) + (hash & (index->size - 1));
+}
+
+/* Append to the end of the bucket chain so that lookups still find the
+ * first of duplicated keys */
+static void ujson_object_index_insert(ujson_object_t* object,
+                                      ujson_object_item_t* item)
+{
+    ujson_object_item_t** slot =
+        ujson_object_bucket(object->index, item->key.hash);
+    while (*slot != NULL)
+    {
+        slot = &(*slot)->chain;
+    }
+    item->chain = NULL;
+    *slot = item;
+}
+
+/* Rebuild the index with at least count buckets */
+static int ujson_object_index_resize(ujson_object_t* object,
+                                     ujson_size_t count)
+{
+    ujson_object_index_t* index;
+    ujson_object_item_t** buckets;
+    ujson_object_item_t** slot;
+    ujson_object_item_t* item_cur;
+    ujson_size_t index_size = UJSON_OBJECT_INDEX_THRESHOLD;
+    ujson_size_t i;
+    while (index_size < count)
+    {
+        index_size *= 2;
+    }
+    if ((index = (ujson_object_index_t*)ujson_malloc(
+             sizeof(ujson_object_index_t) +
+             sizeof(ujson_object_item_t*) * index_size)) == NULL)
+    {
+        return -1;
+    }
+    index->size = index_size;
+    buckets = (ujson_object_item_t**)(index + 1);
+    for (i = 0; i != index_size; i++)
+    {
+        buckets[i] = NULL;
+    }
+    /* Walk backwards and push to the front, keeping members in order */
+    if (object->begin != NULL)
+    {
+        item_cur = object->begin;
+        do
+        {
+            item_cur = item_cur->prev;
+            slot = ujson_object_bucket(index, item_cur->key.hash);
+            item_cur->chain = *slot;
+            *slot = item_cur;
+        } while (item_cur != object->begin);
+    }
+    if (object->index != NULL)
+    {
+        ujson_free(object->index);
+    }
+    object->index = index;
+    return 0;
+}
+
+/* Objects edited by key get indexed once a scan stops being cheap;
+ * without memory for it they are still correct, only slower */
+static void ujson_object_index_ensure(ujson_object_t* object)
+{
+    if ((object->index == NULL) &&
+        (object->size >= UJSON_OBJECT_INDEX_THRESHOLD))
+    {
+        ujson_object_index_resize(object, object->size * 2);
+    }
+}
+
+static ujson_object_item_t* ujson_object_find(ujson_object_t* object,
+                                              const char* name,
+                                              ujson_size_t len,
+                                              unsigned int hash)
+{
+    ujson_object_item_t* item_cur;
+    if (object->index != NULL)
+    {
+        item_cur = *ujson_object_bucket(object->index, hash);
+        while (item_cur != NULL)
+        {
+            if ((item_cur->key.hash == hash) && (item_cur->key.len == len) &&
+                (ujson_memcmp(item_cur->key.s, name, len) == 0))
+            {
+                return item_cur;
+            }
+            item_cur = item_cur->chain;
+        }
+        return NULL;
+    }
+    item_cur = object->begin;
+    while (item_cur != NULL)
+    {
+        if ((item_cur->key.hash == hash) && (item_cur->key.len == len) &&
+            (ujson_memcmp(item_cur->key.s, name, len) == 0))
+        {
+            return item_cur;
+        }
+        item_cur = item_cur->next;
+    }
+    return NULL;
+}
+
 int ujson_object_push_back(ujson_t* object, ujson_object_item_t* new_item)
 {
-    if (object->u.part_object.begin == NULL)
+    ujson_object_t* part_object = &object->u.part_object;
+    if (new_item->value != NULL)
     {
-        object->u.part_object.begin = new_item;
-        object->u.part_object.end = new_item;
+        new_item->value->parent = object;
+    }
+    ujson_fragment_invalidate(object);
+    if (part_object->begin == NULL)
+    {
+        part_object->begin = new_item;
     }
     else
     {
-        object->u.part_object.end->next = new_item;
-        new_item->prev = object->u.part_object.end;
-        object->u.part_object.end = new_item;
+        part_object->begin->prev->next = new_item;
+        new_item->prev = part_object->begin->prev;
+    }
+    part_object->begin->prev = new_item;
+    part_object->size++;
+    if (part_object->index != NULL)
+    {
+        /* Keep at most one member per bucket on average; an index that
+         * can not grow is dropped, lookups then fall back to a scan */
+        if (part_object->size > part_object->index->size)
+        {
+            if (ujson_object_index_resize(part_object,
+                                          part_object->index->size * 2) != 0)
+            {
+                ujson_free(part_object->index);
+                part_object->index = NULL;
+            }
+        }
+        else
+        {
+            ujson_object_index_insert(part_object, new_item);
+        }
+    }
+    return 0;
+}
+
+int ujson_object_reserve(ujson_t* object, ujson_size_t count)
+{
+    ujson_object_t* part_object = &object->u.part_object;
+    if (count < part_object->size)
+    {
+        count = part_object->size;
+    }
+    if ((part_object->index != NULL) && (part_object->index->size >= count))
+    {
+        return 0;
+    }
+    return ujson_object_index_resize(part_object, count);
+}
+
+static ujson_bool ujson_is_ancestor(const ujson_t* ancestor,
+                                    const ujson_t* ujson)
+{
+    for (ujson = ujson->parent; ujson != NULL; ujson = ujson->parent)
+    {
+        if (ujson == ancestor)
+        {
+            return ujson_true;
+        }
+    }
+    return ujson_false;
+}
+
+/* The old value is destroyed only once the new one is linked in, and
+ * never when the new one is the old value or lies inside it */
+static int ujson_object_item_assign(ujson_t* object, ujson_object_item_t* item,
+                                    ujson_t* value)
+{
+    ujson_t* old = item->value;
+    if ((value == old) || (ujson_is_ancestor(old, value) == ujson_true))
+    {
+        return -1;
     }
+    item->value = value;
+    value->parent = object;
+    ujson_fragment_invalidate(object);
+    ujson_destroy_value(old);
     return 0;
 }
 
+/* The item and a copy of its key share one block */
+static ujson_object_item_t* ujson_object_item_new_key(char* key,
+                                                      ujson_size_t len,
+                                                      unsigned int hash,
+                                                      ujson_t* value,
+                                                      ujson_bool copy)
+{
+    ujson_object_item_t* item;
+    if (copy == ujson_true)
+    {
+        item = (ujson_object_item_t*)ujson_malloc(
+            sizeof(ujson_object_item_t) + len + 1);
+    }
+    else
+    {
+        /* Only items of the plain size come from the pool */
+        item = (ujson_object_item_t*)ujson_pool_alloc(UJSON_POOL_OBJECT_ITEM);
+    }
+    if (item == NULL)
+    {
+        return NULL;
+    }
+    item->next = item->prev = NULL;
+    item->chain = NULL;
+    if (copy == ujson_true)
+    {
+        item->key.s = (char*)(item + 1);
+        ujson_memcpy(item->key.s, key, len);
+        item->key.s[len] = '\0';
+    }
+    else
+    {
+        item->key.s = key;
+    }
+    item->key.len = len;
+    item->key.hash = hash;
+    item->key.owned = ujson_false;
+    item->value = value;
+    return item;
+}
+
+static int ujson_object_set_in(ujson_t* object, char* key, ujson_size_t len,
+                               ujson_t* value, ujson_bool copy)
+{
+    ujson_object_t* part_object = &object->u.part_object;
+    ujson_object_item_t* item;
+    unsigned int hash;
+    if (value == NULL)
+    {
+        return -1;
+    }
+    hash = ujson_hash(key, len);
+    ujson_object_index_ensure(part_object);
+    if ((item = ujson_object_find(part_object, key, len, hash)) != NULL)
+    {
+        return ujson_object_item_assign(object, item, value);
+    }
+    if ((item = ujson_object_item_new_key(key, len, hash, value, copy)) ==
+        NULL)
+    {
+        return -1;
+    }
+    return ujson_object_push_back(object, item);
+}
+
+int ujson_object_set(ujson_t* object, const char* key, ujson_size_t len,
+                     ujson_t* value)
+{
+    return ujson_object_set_in(object, (char*)key, len, value, ujson_true);
+}
+
+int ujson_object_set_nocopy(ujson_t* object, char* key, ujson_size_t len,
+                            ujson_t* value)
+{
+    return ujson_object_set_in(object, key, len, value, ujson_false);
+}
+
 /* Inspector */
 
 ujson_type_t ujson_type(ujson_t* ujson) { return ujson->type; }
 
 int ujson_as_integer_value(ujson_t* ujson)
 {
+    if (ujson->u.part_number.raw != NULL)
+    {
+        ujson_number_convert(ujson);
+    }
     return ujson->u.part_number.as_int;
 }
 
 double ujson_as_double_value(ujson_t* ujson)
 {
+    if (ujson->u.part_number.raw != NULL)
+    {
+        ujson_number_convert(ujson);
+    }
     return ujson->u.part_number.as_double;
 }
 
 ujson_bool ujson_as_bool_value(ujson_t* ujson) { return ujson->u.part_bool; }
 
-char* ujson_as_string_body(ujson_t* ujson) { return ujson->u.part_string.s; }
+char* ujson_as_string_body(ujson_t* ujson)
+{
+    if (ujson->u.part_string.lazy != 0)
+    {
+        if (ujson_string_decode_lazy(ujson) != 0)
+        {
+            return NULL;
+        }
+    }
+    return ujson->u.part_string.s;
+}
 
 ujson_size_t ujson_as_string_size_in_character(ujson_t* ujson)
 {
+    const char* p;
+    ujson_size_t len;
+    ujson_size_t ch_len = 0;
+    if (ujson->u.part_string.ch_len == UJSON_STRING_CH_LEN_UNKNOWN)
+    {
+        /* Count the characters by their leading bytes; a span without
+         * escapes has the same characters as the decoded string */
+        if ((ujson->u.part_string.lazy != 0) &&
+            (ujson->u.part_string.escaped != 0) &&
+            (ujson_string_decode_lazy(ujson) != 0))
+        {
+            return 0;
+        }
+        p = ujson->u.part_string.s;
+        len = ujson->u.part_string.len;
+        while (len-- != 0)
+        {
+            if ((*p++ & 0xc0) != 0x80)
+            {
+                ch_len++;
+            }
+        }
+        ujson_string_ch_len_set(ujson, ch_len);
+        return ch_len;
+    }
     return ujson->u.part_string.ch_len;
 }
 
 ujson_size_t ujson_as_string_size_in_utf8_bytes(ujson_t* ujson)
 {
+    if ((ujson->u.part_string.lazy != 0) &&
+        (ujson->u.part_string.escaped != 0))
+    {
+        if (ujson_string_decode_lazy(ujson) != 0)
+        {
+            return 0;
+        }
+    }
     return ujson->u.part_string.len;
 }
 
@@ -799,886 +1912,4694 @@ ujson_t* ujson_as_object_item_value(ujson_object_item_t* item)
     return item->value;
 }
 
+static ujson_t* ujson_as_object_lookup_hashed(ujson_t* object,
+                                              const char* name,
+                                              ujson_size_t len,
+                                              unsigned int hash)
+{
+    ujson_object_item_t* item =
+        ujson_object_find(&object->u.part_object, name, len, hash);
+    return (item != NULL) ? item->value : NULL;
+}
+
 ujson_t* ujson_as_object_lookup(ujson_t* object, char* name, ujson_size_t len)
 {
-    ujson_object_item_t* item_cur = object->u.part_object.begin;
-    unsigned char checksum = ujson_checksum(name, len);
-    while (item_cur != NULL)
+    return ujson_as_object_lookup_hashed(object, name, len,
+                                         ujson_hash(name, len));
+}
+
+/* Walk to the n-th element from whichever end is closer */
+static ujson_array_item_t* ujson_array_item_at(ujson_t* array,
+                                               ujson_size_t index)
+{
+    ujson_array_item_t* item_cur;
+    ujson_size_t size = array->u.part_array.size;
+    if (index >= size)
+    {
+        return NULL;
+    }
+    if (index < size / 2)
     {
-        if ((item_cur->key.len == len) &&
-            (item_cur->key.checksum == checksum) &&
-            (ujson_strncmp(item_cur->key.s, name, len) == 0))
+        item_cur = array->u.part_array.begin;
+        while (index-- != 0)
         {
-            return item_cur->value;
+            item_cur = item_cur->next;
         }
-        item_cur = item_cur->next;
     }
-    return NULL;
+    else
+    {
+        item_cur = array->u.part_array.end;
+        index = size - 1 - index;
+        while (index-- != 0)
+        {
+            item_cur = item_cur->prev;
+        }
+    }
+    return item_cur;
 }
 
-static void ujson_skip_whitespace(char** p_io, ujson_size_t* len_io)
+static ujson_t* ujson_as_array_at(ujson_t* array, ujson_size_t index)
 {
-    while ((*len_io != 0) && (ISWS(**p_io)))
-    {
-        (*p_io)++;
-        (*len_io)--;
-    }
+    ujson_array_item_t* item = ujson_array_item_at(array, index);
+    return (item != NULL) ? item->value : NULL;
 }
 
-static ujson_t* ujson_parse_in_number(char** p_io, ujson_size_t* len_io)
+/* Mutation */
+
+int ujson_array_insert_at(ujson_t* array, ujson_size_t index,
+                          ujson_array_item_t* new_item)
 {
-    char* p = *p_io;
-    ujson_size_t len = *len_io;
-    int value = 0;
-    double value_double = 0.0;
-    ujson_bool negative = ujson_false;
-    ujson_t* result = NULL;
-    double base;
-    /* Negative */
-    if (*p == '-')
+    ujson_array_item_t* item_next;
+    if (index == array->u.part_array.size)
     {
-        negative = ujson_true;
-        p++;
-        len--;
+        return ujson_array_push_back(array, new_item);
     }
-    /* Integer Part */
-    if (len == 0)
+    if ((item_next = ujson_array_item_at(array, index)) == NULL)
     {
-        return NULL;
+        return -1;
     }
-    if (*p == '0')
+    if (new_item->value != NULL)
     {
-        value = 0;
-        p++;
-        len--;
+        new_item->value->parent = array;
     }
-    else if (('1' <= *p) && (*p <= '9'))
+    ujson_fragment_invalidate(array);
+    new_item->next = item_next;
+    new_item->prev = item_next->prev;
+    if (item_next->prev == NULL)
     {
-        while ((len > 0) && (ISDIGIT(*p)))
+        array->u.part_array.begin = new_item;
+    }
+    else
+    {
+        item_next->prev->next = new_item;
+    }
+    item_next->prev = new_item;
+    array->u.part_array.size++;
+    return 0;
+}
+
+static void ujson_array_unlink(ujson_t* array, ujson_array_item_t* item)
+{
+    if (item->prev == NULL)
+    {
+        array->u.part_array.begin = item->next;
+    }
+    else
+    {
+        item->prev->next = item->next;
+    }
+    if (item->next == NULL)
+    {
+        array->u.part_array.end = item->prev;
+    }
+    else
+    {
+        item->next->prev = item->prev;
+    }
+    item->prev = item->next = NULL;
+    array->u.part_array.size--;
+    ujson_fragment_invalidate(array);
+}
+
+int ujson_array_remove_at(ujson_t* array, ujson_size_t index)
+{
+    ujson_array_item_t* item;
+    if ((item = ujson_array_item_at(array, index)) == NULL)
+    {
+        return -1;
+    }
+    ujson_array_unlink(array, item);
+    ujson_array_item_destroy(item);
+    return 0;
+}
+
+static void ujson_object_unlink(ujson_t* container, ujson_object_item_t* item)
+{
+    ujson_object_t* object = &container->u.part_object;
+    ujson_object_item_t** slot;
+    if (object->index != NULL)
+    {
+        slot = ujson_object_bucket(object->index, item->key.hash);
+        while (*slot != item)
+        {
+            slot = &(*slot)->chain;
+        }
+        *slot = item->chain;
+        item->chain = NULL;
+    }
+    if (item == object->begin)
+    {
+        object->begin = item->next;
+    }
+    else
+    {
+        item->prev->next = item->next;
+    }
+    if (item->next != NULL)
+    {
+        item->next->prev = item->prev;
+    }
+    else if (object->begin != NULL)
+    {
+        object->begin->prev = item->prev;
+    }
+    item->prev = item->next = NULL;
+    object->size--;
+    ujson_fragment_invalidate(container);
+}
+
+int ujson_object_remove(ujson_t* object, const char* key, ujson_size_t len)
+{
+    ujson_object_t* part_object = &object->u.part_object;
+    ujson_object_item_t* item;
+    ujson_object_index_ensure(part_object);
+    if ((item = ujson_object_find(part_object, key, len,
+                                  ujson_hash(key, len))) == NULL)
+    {
+        return -1;
+    }
+    ujson_object_unlink(object, item);
+    ujson_object_item_destroy(item);
+    return 0;
+}
+
+int ujson_object_replace(ujson_t* object, const char* key, ujson_size_t len,
+                         ujson_t* value)
+{
+    ujson_object_t* part_object = &object->u.part_object;
+    ujson_object_item_t* item;
+    if (value == NULL)
+    {
+        return -1;
+    }
+    ujson_object_index_ensure(part_object);
+    if ((item = ujson_object_find(part_object, key, len,
+                                  ujson_hash(key, len))) == NULL)
+    {
+        return -1;
+    }
+    return ujson_object_item_assign(object, item, value);
+}
+
+static void ujson_reparent(ujson_t* ujson)
+{
+    ujson_array_item_t* array_item;
+    ujson_object_item_t* object_item;
+    if (ujson->type == UJSON_ARRAY)
+    {
+        for (array_item = ujson->u.part_array.begin; array_item != NULL;
+             array_item = array_item->next)
+        {
+            array_item->value->parent = ujson;
+        }
+    }
+    else if (ujson->type == UJSON_OBJECT)
+    {
+        for (object_item = ujson->u.part_object.begin; object_item != NULL;
+             object_item = object_item->next)
+        {
+            object_item->value->parent = ujson;
+        }
+    }
+}
+
+/* Bodies trade places, each node stays where it is held */
+static void ujson_swap_body(ujson_t* ujson1, ujson_t* ujson2)
+{
+    ujson_t tmp = *ujson1;
+    ujson_t* parent1 = ujson1->parent;
+    ujson_t* parent2 = ujson2->parent;
+    *ujson1 = *ujson2;
+    *ujson2 = tmp;
+    ujson1->parent = parent1;
+    ujson2->parent = parent2;
+    ujson_reparent(ujson1);
+    ujson_reparent(ujson2);
+    ujson_fragment_invalidate(parent1);
+    ujson_fragment_invalidate(parent2);
+}
+
+int ujson_swap(ujson_t* ujson1, ujson_t* ujson2)
+{
+    /* A value swapped with one inside it would end up holding itself */
+    if ((ujson_is_ancestor(ujson1, ujson2) == ujson_true) ||
+        (ujson_is_ancestor(ujson2, ujson1) == ujson_true))
+    {
+        return -1;
+    }
+    ujson_swap_body(ujson1, ujson2);
+    return 0;
+}
+
+/* JSON Pointer */
+
+typedef enum
+{
+    UJSON_POINTER_TOKEN_KEY = 0,
+    UJSON_POINTER_TOKEN_INDEX,
+    UJSON_POINTER_TOKEN_END,
+    UJSON_POINTER_TOKEN_ANY_KEY,
+    UJSON_POINTER_TOKEN_ANY_INDEX,
+} ujson_pointer_token_type_t;
+
+struct ujson_pointer_token
+{
+    ujson_pointer_token_type_t type;
+    char* s;
+    ujson_size_t len;
+    unsigned int hash;
+    ujson_size_t index;
+};
+typedef struct ujson_pointer_token ujson_pointer_token_t;
+
+struct ujson_pointer
+{
+    ujson_pointer_token_t* tokens;
+    ujson_size_t size;
+};
+
+/* A reference token is an array index if it is "0" or has no leading zero */
+static void ujson_pointer_token_classify(ujson_pointer_token_t* token)
+{
+    ujson_size_t i;
+    ujson_size_t index = 0;
+    token->type = UJSON_POINTER_TOKEN_KEY;
+    token->index = 0;
+    if ((token->len == 1) && (token->s[0] == '-'))
+    {
+        token->type = UJSON_POINTER_TOKEN_END;
+        return;
+    }
+    if ((token->len == 0) || ((token->len > 1) && (token->s[0] == '0')))
+    {
+        return;
+    }
+    for (i = 0; i != token->len; i++)
+    {
+        if (!ISDIGIT(token->s[i]))
+        {
+            return;
+        }
+        if (index > (((ujson_size_t)-1) - 9) / 10)
+        {
+            return;
+        }
+        index = index * 10 + (ujson_size_t)(token->s[i] - '0');
+    }
+    token->type = UJSON_POINTER_TOKEN_INDEX;
+    token->index = index;
+}
+
+ujson_pointer_t* ujson_pointer_compile(const char* s, ujson_size_t len)
+{
+    ujson_pointer_t* ptr;
+    ujson_pointer_token_t* token;
+    char* body;
+    ujson_size_t count = 0;
+    ujson_size_t i;
+
+    if ((len != 0) && (s[0] != '/'))
+    {
+        return NULL;
+    }
+    for (i = 0; i != len; i++)
+    {
+        if (s[i] == '/')
+        {
+            count++;
+        }
+        else if ((s[i] == '~') &&
+                 ((i + 1 == len) || ((s[i + 1] != '0') && (s[i + 1] != '1'))))
+        {
+            return NULL;
+        }
+    }
+
+    /* Header, tokens and unescaped token bodies share one allocation;
+     * the bodies never outgrow the source since '~0' and '~1' shrink */
+    if ((ptr = (ujson_pointer_t*)ujson_malloc(
+             sizeof(ujson_pointer_t) + sizeof(ujson_pointer_token_t) * count +
+             sizeof(char) * (len + 1))) == NULL)
+    {
+        return NULL;
+    }
+    ptr->tokens = (ujson_pointer_token_t*)(ptr + 1);
+    ptr->size = count;
+    body = (char*)(ptr->tokens + count);
+
+    token = ptr->tokens;
+    for (i = 0; i != len;)
+    {
+        /* Skip '/' */
+        i++;
+        token->s = body;
+        token->len = 0;
+        while ((i != len) && (s[i] != '/'))
+        {
+            if (s[i] == '~')
+            {
+                body[token->len++] = (s[i + 1] == '0') ? '~' : '/';
+                i += 2;
+            }
+            else
+            {
+                body[token->len++] = s[i++];
+            }
+        }
+        body[token->len] = '\0';
+        body += token->len + 1;
+        token->hash = ujson_hash(token->s, token->len);
+        ujson_pointer_token_classify(token);
+        token++;
+    }
+
+    return ptr;
+}
+
+ujson_t* ujson_pointer_get(ujson_t* ujson, const ujson_pointer_t* ptr)
+{
+    const ujson_pointer_token_t* token = ptr->tokens;
+    const ujson_pointer_token_t* token_end = ptr->tokens + ptr->size;
+
+    while ((ujson != NULL) && (token != token_end))
+    {
+        switch (ujson->type)
+        {
+        case UJSON_OBJECT:
+            ujson = ujson_as_object_lookup_hashed(ujson, token->s, token->len,
+                                                  token->hash);
+            break;
+        case UJSON_ARRAY:
+            if (token->type != UJSON_POINTER_TOKEN_INDEX)
+            {
+                return NULL;
+            }
+            ujson = ujson_as_array_at(ujson, token->index);
+            break;
+        default:
+            return NULL;
+        }
+        token++;
+    }
+
+    return ujson;
+}
+
+void ujson_pointer_destroy(ujson_pointer_t* ptr) { ujson_free(ptr); }
+
+/* JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7396) */
+
+/* Values put into the document are clones or subtrees already unlinked
+ * from it, so they are swapped in without searching for one inside the
+ * other */
+
+/* Deep copy; lazy nodes are converted so that the copy does not refer to
+ * the source text of the original */
+static ujson_t* ujson_clone(ujson_t* ujson)
+{
+    ujson_t* new_ujson = NULL;
+    ujson_t* new_value;
+    ujson_array_item_t* array_item;
+    ujson_array_item_t* new_array_item;
+    ujson_object_item_t* object_item;
+    ujson_object_item_t* new_object_item;
+
+    switch (ujson->type)
+    {
+    case UJSON_NULL:
+    case UJSON_UNDEFINED:
+        return ujson_new(ujson->type);
+    case UJSON_BOOL:
+        return ujson_new_bool(ujson->u.part_bool);
+    case UJSON_NUMEBR:
+        if (ujson->u.part_number.raw != NULL)
+        {
+            ujson_number_convert(ujson);
+        }
+        if ((new_ujson = ujson_new(UJSON_NUMEBR)) == NULL)
+        {
+            return NULL;
+        }
+        new_ujson->u.part_number.as_int = ujson->u.part_number.as_int;
+        new_ujson->u.part_number.as_double = ujson->u.part_number.as_double;
+        new_ujson->u.part_number.is_double = ujson->u.part_number.is_double;
+        return new_ujson;
+    case UJSON_STRING:
+        if ((ujson->u.part_string.lazy != 0) &&
+            (ujson_string_decode_lazy(ujson) != 0))
+        {
+            return NULL;
+        }
+        if ((new_ujson = ujson_new_string2(ujson->u.part_string.s,
+                                           ujson->u.part_string.len,
+                                           ujson->u.part_string.ch_len)) !=
+            NULL)
+        {
+            new_ujson->u.part_string.plain = ujson->u.part_string.plain;
+        }
+        return new_ujson;
+    case UJSON_ARRAY:
+        if ((new_ujson = ujson_new_array()) == NULL)
+        {
+            return NULL;
+        }
+        for (array_item = ujson->u.part_array.begin; array_item != NULL;
+             array_item = array_item->next)
+        {
+            if ((new_value = ujson_clone(array_item->value)) == NULL)
+            {
+                goto fail;
+            }
+            if ((new_array_item = ujson_array_item_new(new_value)) == NULL)
+            {
+                ujson_destroy_value(new_value);
+                goto fail;
+            }
+            ujson_array_push_back(new_ujson, new_array_item);
+        }
+        return new_ujson;
+    case UJSON_OBJECT:
+        if ((new_ujson = ujson_new_object()) == NULL)
+        {
+            return NULL;
+        }
+        for (object_item = ujson->u.part_object.begin; object_item != NULL;
+             object_item = object_item->next)
+        {
+            if ((new_value = ujson_clone(object_item->value)) == NULL)
+            {
+                goto fail;
+            }
+            if ((new_object_item = ujson_object_item_new_key(
+                     object_item->key.s, object_item->key.len,
+                     object_item->key.hash, new_value, ujson_true)) == NULL)
+            {
+                ujson_destroy_value(new_value);
+                goto fail;
+            }
+            ujson_object_push_back(new_ujson, new_object_item);
+        }
+        return new_ujson;
+    }
+fail:
+    if (new_ujson != NULL)
+    {
+        ujson_destroy_value(new_ujson);
+    }
+    return NULL;
+}
+
+static ujson_bool ujson_equal(ujson_t* ujson1, ujson_t* ujson2)
+{
+    ujson_array_item_t *array_item1, *array_item2;
+    ujson_object_item_t *object_item1, *object_item2;
+
+    if (ujson1->type != ujson2->type)
+    {
+        return ujson_false;
+    }
+    switch (ujson1->type)
+    {
+    case UJSON_NULL:
+    case UJSON_UNDEFINED:
+        return ujson_true;
+    case UJSON_BOOL:
+        return (ujson1->u.part_bool == ujson2->u.part_bool) ? ujson_true
+                                                             : ujson_false;
+    case UJSON_NUMEBR:
+        return (ujson_as_double_value(ujson1) == ujson_as_double_value(ujson2))
+                   ? ujson_true
+                   : ujson_false;
+    case UJSON_STRING:
+        if (((ujson1->u.part_string.lazy != 0) &&
+             (ujson_string_decode_lazy(ujson1) != 0)) ||
+            ((ujson2->u.part_string.lazy != 0) &&
+             (ujson_string_decode_lazy(ujson2) != 0)))
+        {
+            return ujson_false;
+        }
+        return ((ujson1->u.part_string.len == ujson2->u.part_string.len) &&
+                (ujson_memcmp(ujson1->u.part_string.s, ujson2->u.part_string.s,
+                              ujson1->u.part_string.len) == 0))
+                   ? ujson_true
+                   : ujson_false;
+    case UJSON_ARRAY:
+        if (ujson1->u.part_array.size != ujson2->u.part_array.size)
+        {
+            return ujson_false;
+        }
+        array_item1 = ujson1->u.part_array.begin;
+        array_item2 = ujson2->u.part_array.begin;
+        while (array_item1 != NULL)
+        {
+            if (ujson_equal(array_item1->value, array_item2->value) ==
+                ujson_false)
+            {
+                return ujson_false;
+            }
+            array_item1 = array_item1->next;
+            array_item2 = array_item2->next;
+        }
+        return ujson_true;
+    case UJSON_OBJECT:
+        if (ujson1->u.part_object.size != ujson2->u.part_object.size)
+        {
+            return ujson_false;
+        }
+        ujson_object_index_ensure(&ujson2->u.part_object);
+        for (object_item1 = ujson1->u.part_object.begin; object_item1 != NULL;
+             object_item1 = object_item1->next)
+        {
+            if (((object_item2 = ujson_object_find(
+                      &ujson2->u.part_object, object_item1->key.s,
+                      object_item1->key.len, object_item1->key.hash)) ==
+                 NULL) ||
+                (ujson_equal(object_item1->value, object_item2->value) ==
+                 ujson_false))
+            {
+                return ujson_false;
+            }
+        }
+        return ujson_true;
+    }
+    return ujson_false;
+}
+
+/* The container holding the last token of ptr, NULL for the root */
+static ujson_t* ujson_patch_parent(ujson_t* doc, const ujson_pointer_t* ptr)
+{
+    ujson_pointer_t parent_ptr;
+    parent_ptr.tokens = ptr->tokens;
+    parent_ptr.size = ptr->size - 1;
+    return ujson_pointer_get(doc, &parent_ptr);
+}
+
+/* Unlink the value at ptr from its container and hand it over */
+static ujson_t* ujson_patch_take(ujson_t* doc, const ujson_pointer_t* ptr)
+{
+    const ujson_pointer_token_t* token;
+    ujson_t* parent;
+    ujson_t* value;
+    ujson_array_item_t* array_item;
+    ujson_object_item_t* object_item;
+
+    if ((ptr->size == 0) || ((parent = ujson_patch_parent(doc, ptr)) == NULL))
+    {
+        return NULL;
+    }
+    token = &ptr->tokens[ptr->size - 1];
+    if (parent->type == UJSON_OBJECT)
+    {
+        ujson_object_index_ensure(&parent->u.part_object);
+        if ((object_item =
+                 ujson_object_find(&parent->u.part_object, token->s,
+                                   token->len, token->hash)) == NULL)
+        {
+            return NULL;
+        }
+        ujson_object_unlink(parent, object_item);
+        value = object_item->value;
+        object_item->value = NULL;
+        ujson_object_item_destroy(object_item);
+        value->parent = NULL;
+        return value;
+    }
+    if ((parent->type != UJSON_ARRAY) ||
+        (token->type != UJSON_POINTER_TOKEN_INDEX) ||
+        ((array_item = ujson_array_item_at(parent, token->index)) == NULL))
+    {
+        return NULL;
+    }
+    ujson_array_unlink(parent, array_item);
+    value = array_item->value;
+    array_item->value = NULL;
+    ujson_array_item_destroy(array_item);
+    value->parent = NULL;
+    return value;
+}
+
+/* Place value at ptr, taking it over unless this fails */
+static int ujson_patch_add(ujson_t* doc, const ujson_pointer_t* ptr,
+                           ujson_t* value)
+{
+    const ujson_pointer_token_t* token;
+    ujson_t* parent;
+    ujson_array_item_t* array_item;
+
+    if (ptr->size == 0)
+    {
+        ujson_swap_body(doc, value);
+        ujson_destroy_value(value);
+        return 0;
+    }
+    if ((parent = ujson_patch_parent(doc, ptr)) == NULL)
+    {
+        return -1;
+    }
+    token = &ptr->tokens[ptr->size - 1];
+    if (parent->type == UJSON_OBJECT)
+    {
+        return ujson_object_set_in(parent, token->s, token->len, value,
+                                   ujson_true);
+    }
+    if ((parent->type != UJSON_ARRAY) ||
+        ((token->type != UJSON_POINTER_TOKEN_END) &&
+         ((token->type != UJSON_POINTER_TOKEN_INDEX) ||
+          (token->index > parent->u.part_array.size))))
+    {
+        return -1;
+    }
+    if ((array_item = ujson_array_item_new(value)) == NULL)
+    {
+        return -1;
+    }
+    if (token->type == UJSON_POINTER_TOKEN_END)
+    {
+        return ujson_array_push_back(parent, array_item);
+    }
+    return ujson_array_insert_at(parent, token->index, array_item);
+}
+
+/* ptr1 names ptr2 or one of its ancestors */
+static ujson_bool ujson_pointer_is_prefix(const ujson_pointer_t* ptr1,
+                                          const ujson_pointer_t* ptr2)
+{
+    ujson_size_t i;
+    if (ptr1->size > ptr2->size)
+    {
+        return ujson_false;
+    }
+    for (i = 0; i != ptr1->size; i++)
+    {
+        if ((ptr1->tokens[i].len != ptr2->tokens[i].len) ||
+            (ujson_memcmp(ptr1->tokens[i].s, ptr2->tokens[i].s,
+                          ptr1->tokens[i].len) != 0))
+        {
+            return ujson_false;
+        }
+    }
+    return ujson_true;
+}
+
+static ujson_pointer_t* ujson_patch_member_pointer(ujson_t* operation,
+                                                   char* name,
+                                                   ujson_size_t len)
+{
+    ujson_t* member;
+    char* body;
+    if (((member = ujson_as_object_lookup(operation, name, len)) == NULL) ||
+        (member->type != UJSON_STRING) ||
+        (((body = ujson_as_string_body(member)) == NULL) &&
+         (member->u.part_string.len != 0)))
+    {
+        return NULL;
+    }
+    return ujson_pointer_compile(body, member->u.part_string.len);
+}
+
+static int ujson_patch_apply_operation(ujson_t* doc, ujson_t* operation)
+{
+    int ret = -1;
+    ujson_t* op;
+    char* op_s;
+    ujson_size_t op_len;
+    ujson_t* value;
+    ujson_t* target;
+    ujson_pointer_t* path = NULL;
+    ujson_pointer_t* from = NULL;
+
+    if ((operation->type != UJSON_OBJECT) ||
+        ((op = ujson_as_object_lookup(operation, "op", 2)) == NULL) ||
+        (op->type != UJSON_STRING) ||
+        ((op_s = ujson_as_string_body(op)) == NULL) ||
+        ((path = ujson_patch_member_pointer(operation, "path", 4)) == NULL))
+    {
+        goto fail;
+    }
+    op_len = op->u.part_string.len;
+    value = ujson_as_object_lookup(operation, "value", 5);
+
+    if ((op_len == 3) && (ujson_strncmp(op_s, "add", 3) == 0))
+    {
+        if ((value == NULL) || ((value = ujson_clone(value)) == NULL))
+        {
+            goto fail;
+        }
+        if (ujson_patch_add(doc, path, value) != 0)
+        {
+            ujson_destroy_value(value);
+            goto fail;
+        }
+    }
+    else if ((op_len == 6) && (ujson_strncmp(op_s, "remove", 6) == 0))
+    {
+        if ((value = ujson_patch_take(doc, path)) == NULL)
+        {
+            goto fail;
+        }
+        ujson_destroy_value(value);
+    }
+    else if ((op_len == 7) && (ujson_strncmp(op_s, "replace", 7) == 0))
+    {
+        /* The old value is swapped out from wherever it is held */
+        if ((value == NULL) ||
+            ((target = ujson_pointer_get(doc, path)) == NULL) ||
+            ((value = ujson_clone(value)) == NULL))
+        {
+            goto fail;
+        }
+        ujson_swap_body(target, value);
+        ujson_destroy_value(value);
+    }
+    else if ((op_len == 4) && (ujson_strncmp(op_s, "move", 4) == 0))
+    {
+        /* The subtree is relinked, not copied, and can not be moved
+         * into one of its own children */
+        if ((from = ujson_patch_member_pointer(operation, "from", 4)) == NULL)
+        {
+            goto fail;
+        }
+        if (ujson_pointer_is_prefix(from, path) == ujson_true)
+        {
+            if ((from->size != path->size) ||
+                (ujson_pointer_get(doc, from) == NULL))
+            {
+                goto fail;
+            }
+        }
+        else
+        {
+            if ((value = ujson_patch_take(doc, from)) == NULL)
+            {
+                goto fail;
+            }
+            if (ujson_patch_add(doc, path, value) != 0)
+            {
+                ujson_destroy_value(value);
+                goto fail;
+            }
+        }
+    }
+    else if ((op_len == 4) && (ujson_strncmp(op_s, "copy", 4) == 0))
+    {
+        if (((from = ujson_patch_member_pointer(operation, "from", 4)) ==
+             NULL) ||
+            ((target = ujson_pointer_get(doc, from)) == NULL) ||
+            ((value = ujson_clone(target)) == NULL))
+        {
+            goto fail;
+        }
+        if (ujson_patch_add(doc, path, value) != 0)
+        {
+            ujson_destroy_value(value);
+            goto fail;
+        }
+    }
+    else if ((op_len == 4) && (ujson_strncmp(op_s, "test", 4) == 0))
+    {
+        if ((value == NULL) ||
+            ((target = ujson_pointer_get(doc, path)) == NULL) ||
+            (ujson_equal(target, value) == ujson_false))
+        {
+            goto fail;
+        }
+    }
+    else
+    {
+        goto fail;
+    }
+    ret = 0;
+fail:
+    if (path != NULL)
+    {
+        ujson_pointer_destroy(path);
+    }
+    if (from != NULL)
+    {
+        ujson_pointer_destroy(from);
+    }
+    return ret;
+}
+
+int ujson_patch_apply(ujson_t* doc, ujson_t* patch)
+{
+    ujson_array_item_t* item_cur;
+    if (patch->type != UJSON_ARRAY)
+    {
+        return -1;
+    }
+    for (item_cur = patch->u.part_array.begin; item_cur != NULL;
+         item_cur = item_cur->next)
+    {
+        if (ujson_patch_apply_operation(doc, item_cur->value) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int ujson_merge_patch_in(ujson_t* target, ujson_t* patch)
+{
+    ujson_t* value;
+    ujson_object_item_t* item_cur;
+    ujson_object_item_t* target_item;
+
+    if (patch->type != UJSON_OBJECT)
+    {
+        if ((value = ujson_clone(patch)) == NULL)
+        {
+            return -1;
+        }
+        ujson_swap_body(target, value);
+        ujson_destroy_value(value);
+        return 0;
+    }
+    if (target->type != UJSON_OBJECT)
+    {
+        if ((value = ujson_new_object()) == NULL)
+        {
+            return -1;
+        }
+        ujson_swap_body(target, value);
+        ujson_destroy_value(value);
+    }
+    for (item_cur = patch->u.part_object.begin; item_cur != NULL;
+         item_cur = item_cur->next)
+    {
+        if (item_cur->value->type == UJSON_NULL)
+        {
+            ujson_object_remove(target, item_cur->key.s, item_cur->key.len);
+            continue;
+        }
+        ujson_object_index_ensure(&target->u.part_object);
+        if ((target_item = ujson_object_find(
+                 &target->u.part_object, item_cur->key.s, item_cur->key.len,
+                 item_cur->key.hash)) != NULL)
+        {
+            /* Merged into the existing member, untouched parts stay */
+            if (ujson_merge_patch_in(target_item->value, item_cur->value) !=
+                0)
+            {
+                return -1;
+            }
+            continue;
+        }
+        /* A new member is the patch value with its null members dropped */
+        if ((value = ujson_new_null()) == NULL)
+        {
+            return -1;
+        }
+        if ((ujson_merge_patch_in(value, item_cur->value) != 0) ||
+            (ujson_object_set_in(target, item_cur->key.s, item_cur->key.len,
+                                 value, ujson_true) != 0))
+        {
+            ujson_destroy_value(value);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int ujson_merge_patch_apply(ujson_t* doc, ujson_t* patch)
+{
+    return ujson_merge_patch_in(doc, patch);
+}
+
+static void ujson_skip_whitespace(char** p_io, ujson_size_t* len_io)
+{
+    while ((*len_io != 0) && (UJSON_CHAR_CLASS(**p_io) == UJSON_CHAR_WS))
+    {
+        (*p_io)++;
+        (*len_io)--;
+    }
+}
+
+/* Padded input (ujson_parse_padded) is followed by a zero sentinel that no
+ * scanner accepts, so runs are measured without counting the length down
+ * and strings are scanned a word at a time */
+#define UJSON_SWAR_ONES (~0UL / 255)
+#define UJSON_SWAR_HAS_ZERO(v)                                                 \
+    (((v)-UJSON_SWAR_ONES) & ~(v) & (UJSON_SWAR_ONES * 128))
+#define UJSON_SWAR_HAS_BYTE(v, b)                                              \
+    UJSON_SWAR_HAS_ZERO((v) ^ (UJSON_SWAR_ONES * (unsigned char)(b)))
+/* A byte below 0x20, above 0x7f, '"' or '\\' ends a plain string run
+ * (and '/' one that is written back) */
+#define UJSON_SWAR_HAS_LESS(v, n)                                              \
+    (((v)-UJSON_SWAR_ONES * (n)) & ~(v) & (UJSON_SWAR_ONES * 128))
+#define UJSON_SWAR_STRING_STOP(v)                                              \
+    (((v) & (UJSON_SWAR_ONES * 128)) | UJSON_SWAR_HAS_LESS(v, 0x20) |          \
+     UJSON_SWAR_HAS_BYTE(v, '"') | UJSON_SWAR_HAS_BYTE(v, '\\'))
+#define UJSON_SWAR_ESCAPE_STOP(v)                                              \
+    (UJSON_SWAR_STRING_STOP(v) | UJSON_SWAR_HAS_BYTE(v, '/'))
+
+/* Bytes are only ever tested all at once, so their order in the word does
+ * not matter; the copy compiles down to a single unaligned load */
+static unsigned long ujson_load_long(const char* p)
+{
+    unsigned long value;
+    ujson_memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void ujson_skip_whitespace_padded(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    while (UJSON_CHAR_CLASS(*p) == UJSON_CHAR_WS)
+    {
+        p++;
+    }
+    *len_io -= (ujson_size_t)(p - *p_io);
+    *p_io = p;
+}
+
+static void ujson_parse_skip_whitespace(ujson_parse_ctx_t* ctx, char** p_io,
+                                        ujson_size_t* len_io)
+{
+    if (ctx->config->padded == ujson_true)
+    {
+        ujson_skip_whitespace_padded(p_io, len_io);
+    }
+    else
+    {
+        ujson_skip_whitespace(p_io, len_io);
+    }
+}
+
+static ujson_size_t ujson_span_digits(const char* p, ujson_size_t len,
+                                      ujson_bool padded)
+{
+    const char* start = p;
+    if (padded == ujson_true)
+    {
+        while (ISDIGIT(*p))
+        {
+            p++;
+        }
+    }
+    else
+    {
+        while ((len > 0) && (ISDIGIT(*p)))
+        {
+            p++;
+            len--;
+        }
+    }
+    return (ujson_size_t)(p - start);
+}
+
+/* Length of the run before the next '"', '\\' or zero byte */
+static ujson_size_t ujson_span_string_padded(const char* p)
+{
+    const char* start = p;
+    unsigned long word;
+    for (;;)
+    {
+        word = ujson_load_long(p);
+        if ((UJSON_SWAR_HAS_BYTE(word, '"') |
+             UJSON_SWAR_HAS_BYTE(word, '\\') | UJSON_SWAR_HAS_ZERO(word)) != 0)
+        {
+            break;
+        }
+        p += sizeof(unsigned long);
+    }
+    while ((*p != '"') && (*p != '\\') && (*p != '\0'))
+    {
+        p++;
+    }
+    return (ujson_size_t)(p - start);
+}
+
+static int ujson_skip_string(char** p_io, ujson_size_t* len_io,
+                             ujson_bool* escaped, ujson_bool padded)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_size_t run;
+    *escaped = ujson_false;
+    /* Skip '"' */
+    p++;
+    len--;
+    while ((len != 0) && (*p != '"'))
+    {
+        if (*p == '\\')
+        {
+            if (len < 2)
+            {
+                return -1;
+            }
+            switch (*(p + 1))
+            {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                if ((len < 6) || (!ISHEXDIGIT_S4(p + 2)))
+                {
+                    return -1;
+                }
+                break;
+            default:
+                return -1;
+            }
+            *escaped = ujson_true;
+            p += 2;
+            len -= 2;
+        }
+        else if (padded == ujson_true)
+        {
+            /* A run ending in the sentinel leaves the string unterminated */
+            run = ujson_span_string_padded(p + 1) + 1;
+            run = (run < len) ? run : len;
+            p += run;
+            len -= run;
+        }
+        else
+        {
+            p++;
+            len--;
+        }
+    }
+    if (len == 0)
+    {
+        return -1;
+    }
+    /* Skip '"' */
+    p++;
+    len--;
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+static int ujson_skip_number(char** p_io, ujson_size_t* len_io,
+                             ujson_bool padded)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_size_t run;
+    if (*p == '-')
+    {
+        p++;
+        len--;
+    }
+    if ((len == 0) || (!ISDIGIT(*p)))
+    {
+        return -1;
+    }
+    if (*p == '0')
+    {
+        p++;
+        len--;
+    }
+    else
+    {
+        run = ujson_span_digits(p, len, padded);
+        p += run;
+        len -= run;
+    }
+    if ((len > 0) && (*p == '.'))
+    {
+        p++;
+        len--;
+        run = ujson_span_digits(p, len, padded);
+        p += run;
+        len -= run;
+    }
+    if ((len > 0) && ((*p == 'e') || (*p == 'E')))
+    {
+        p++;
+        len--;
+        if ((len > 0) && ((*p == '+') || (*p == '-')))
+        {
+            p++;
+            len--;
+        }
+        if ((len == 0) || (!ISDIGIT(*p)))
+        {
+            return -1;
+        }
+        run = ujson_span_digits(p, len, padded);
+        p += run;
+        len -= run;
+    }
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+/* The integer view of a number saturates instead of overflowing */
+#define UJSON_LEX_NUMBER_TO_INT(d)                                             \
+    (((d) < 2147483647.0) ? (int)(d) : 2147483647)
+
+/* Powers of ten that a double holds exactly */
+static const double g_ujson_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* Significant digits are gathered while the mantissa stays exact */
+#define UJSON_LEX_NUMBER_MANTISSA_MAX 9e14
+
+/* Scale an exact mantissa by a power of ten; one rounding step when both
+ * are exact, otherwise the C library reads the lexeme */
+static double ujson_lex_number_scale(const char* lexeme, ujson_size_t len,
+                                     double mantissa, int exponent10,
+                                     ujson_bool exact)
+{
+    char buf[64];
+    double value;
+    if ((exact == ujson_true) && (-22 <= exponent10) && (exponent10 <= 22))
+    {
+        return (exponent10 < 0) ? mantissa / g_ujson_pow10[-exponent10]
+                                : mantissa * g_ujson_pow10[exponent10];
+    }
+    if (len < sizeof(buf))
+    {
+        ujson_memcpy(buf, lexeme, len);
+        buf[len] = '\0';
+        if (sscanf(buf, "%lf", &value) == 1)
+        {
+            return value;
+        }
+    }
+    value = mantissa;
+    for (; exponent10 > 0; exponent10--)
+    {
+        value *= 10;
+    }
+    for (; exponent10 < 0; exponent10++)
+    {
+        value /= 10;
+    }
+    return value;
+}
+
+static int ujson_lex_number(char** p_io, ujson_size_t* len_io,
+                            int* value_out, double* value_double_out,
+                            ujson_bool* is_double_out, ujson_bool padded)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    char* lexeme;
+    double value_double;
+    double mantissa = 0.0;
+    int exponent10 = 0;
+    ujson_bool exact = ujson_true;
+    ujson_bool negative = ujson_false;
+    ujson_bool is_double = ujson_false;
+    ujson_bool exponent_negative = ujson_false;
+    int exponent = 0;
+    ujson_size_t run;
+    ujson_size_t i;
+    /* Negative */
+    if (*p == '-')
+    {
+        negative = ujson_true;
+        p++;
+        len--;
+    }
+    lexeme = p;
+    /* Integer Part */
+    if (len == 0)
+    {
+        return -1;
+    }
+    if (*p == '0')
+    {
+        p++;
+        len--;
+    }
+    else if (('1' <= *p) && (*p <= '9'))
+    {
+        run = ujson_span_digits(p, len, padded);
+        for (i = 0; i != run; i++)
+        {
+            if (mantissa < UJSON_LEX_NUMBER_MANTISSA_MAX)
+            {
+                mantissa = mantissa * 10 + (p[i] - '0');
+            }
+            else
+            {
+                exponent10++;
+                exact = (p[i] == '0') ? exact : ujson_false;
+            }
+        }
+        p += run;
+        len -= run;
+    }
+    else
+    {
+        return -1;
+    }
+    /* Fractal Part */
+    if ((len > 0) && (*p == '.'))
+    {
+        is_double = ujson_true;
+        /* Skip '.' */
+        p++;
+        len--;
+        run = ujson_span_digits(p, len, padded);
+        for (i = 0; i != run; i++)
+        {
+            if (mantissa < UJSON_LEX_NUMBER_MANTISSA_MAX)
+            {
+                mantissa = mantissa * 10 + (p[i] - '0');
+                exponent10--;
+            }
+            else
+            {
+                exact = (p[i] == '0') ? exact : ujson_false;
+            }
+        }
+        p += run;
+        len -= run;
+    }
+    /* Exponent Part */
+    if ((len > 0) && ((*p == 'e') || (*p == 'E')))
+    {
+        is_double = ujson_true;
+        /* Skip 'e' */
+        p++;
+        len--;
+        if ((len > 0) && ((*p == '+') || (*p == '-')))
+        {
+            exponent_negative = (*p == '-') ? ujson_true : ujson_false;
+            p++;
+            len--;
+        }
+        if ((len == 0) || (!ISDIGIT(*p)))
+        {
+            return -1;
+        }
+        run = ujson_span_digits(p, len, padded);
+        for (i = 0; i != run; i++)
+        {
+            if (exponent < 10000)
+            {
+                exponent = exponent * 10 + (p[i] - '0');
+            }
+        }
+        p += run;
+        len -= run;
+        exponent10 += (exponent_negative == ujson_true) ? -exponent : exponent;
+    }
+    value_double = ujson_lex_number_scale(lexeme, (ujson_size_t)(p - lexeme),
+                                          mantissa, exponent10, exact);
+    /* Negative */
+    if (negative == ujson_true)
+    {
+        value_double = -value_double;
+    }
+    *value_out = (negative == ujson_true)
+                     ? -UJSON_LEX_NUMBER_TO_INT(-value_double)
+                     : UJSON_LEX_NUMBER_TO_INT(value_double);
+    *value_double_out = value_double;
+    *is_double_out = is_double;
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+/* Convert the lexeme of a lazily parsed number on first access */
+static void ujson_number_convert(ujson_t* ujson)
+{
+    char* p = ujson->u.part_number.raw;
+    ujson_size_t len = ujson->u.part_number.raw_len;
+    ujson_bool is_double = ujson_false;
+    if (ujson->u.part_number.converted == ujson_true)
+    {
+        return;
+    }
+    ujson_lex_number(&p, &len, &ujson->u.part_number.as_int,
+                     &ujson->u.part_number.as_double, &is_double, ujson_false);
+    ujson->u.part_number.is_double = is_double;
+    ujson->u.part_number.converted = ujson_true;
+}
+
+static ujson_t* ujson_parse_in_number(ujson_parse_ctx_t* ctx, char** p_io,
+                                      ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* result;
+    int value;
+    double value_double;
+    ujson_bool is_double;
+    if (ctx->config->lazy_number == ujson_true)
+    {
+        /* Only find the end of the lexeme now */
+        if (ujson_skip_number(p_io, len_io, ctx->config->padded) != 0)
+        {
+            return NULL;
+        }
+        if ((ujson_size_t)(*p_io - p) > UJSON_NUMBER_RAW_LEN_MAX)
+        {
+            /* Too long to keep, converted right away */
+            *p_io = p;
+            *len_io = len;
+            goto convert;
+        }
+        if ((result = ujson_new(UJSON_NUMEBR)) == NULL)
+        {
+            return NULL;
+        }
+        result->u.part_number.raw = p;
+        result->u.part_number.raw_len = (unsigned int)(*p_io - p);
+        result->u.part_number.converted = ujson_false;
+        return result;
+    }
+convert:
+    if (ujson_lex_number(p_io, len_io, &value, &value_double, &is_double,
+                         ctx->config->padded) != 0)
+    {
+        return NULL;
+    }
+    if ((result = ujson_new_number(value, value_double)) != NULL)
+    {
+        result->u.part_number.is_double = is_double;
+    }
+    return result;
+}
+
+static ujson_t* ujson_parse_in_string(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* result = NULL;
+    ujson_mbuf_t buffer;
+    ujson_size_t ch_len;
+    ujson_bool plain;
+    /* Initialize buffer */
+    if (ujson_mbuf_init(&buffer) != 0)
+    {
+        return NULL;
+    }
+    /* Skip '"' */
+    p++;
+    len--;
+    if (ujson_string_decode(&p, &len, &buffer, &ch_len, &plain) != 0)
+    {
+        goto fail;
+    }
+    if (len == 0)
+    {
+        goto fail;
+    }
+    /* Skip '"' */
+    p++;
+    len--;
+    if ((result = ujson_new_string2(ujson_mbuf_body(&buffer),
+                                    ujson_mbuf_size(&buffer), ch_len)) == NULL)
+    {
+        goto fail;
+    }
+    result->u.part_string.plain = plain;
+    *p_io = p;
+    *len_io = len;
+fail:
+    /* Uninitialize buffer */
+    ujson_mbuf_uninit(&buffer);
+    return result;
+}
+
+/* Only find the end of the string now */
+static ujson_t* ujson_parse_in_string_lazy(ujson_parse_ctx_t* ctx,
+                                            char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_t* result;
+    ujson_bool escaped;
+    if (ujson_skip_string(p_io, len_io, &escaped, ctx->config->padded) != 0)
+    {
+        return NULL;
+    }
+    if ((result = ujson_new(UJSON_STRING)) == NULL)
+    {
+        return NULL;
+    }
+    result->u.part_string.s = p + 1;
+    result->u.part_string.len = (ujson_size_t)(*p_io - p) - 2;
+    result->u.part_string.lazy = 1;
+    result->u.part_string.escaped = (escaped == ujson_true) ? 1 : 0;
+    result->u.part_string.ch_len = UJSON_STRING_CH_LEN_UNKNOWN;
+    return result;
+}
+
+/* Decode a lazily parsed string into its own buffer */
+static int ujson_string_decode_lazy(ujson_t* ujson)
+{
+    char* p = ujson->u.part_string.s;
+    ujson_size_t len = ujson->u.part_string.len;
+    ujson_mbuf_t buffer;
+    ujson_size_t ch_len;
+    ujson_t* decoded;
+
+    if (ujson->u.part_string.lazy == 0)
+    {
+        return 0;
+    }
+    if (ujson->u.part_string.escaped == 0)
+    {
+        decoded = ujson_new_string2(p, len, ujson->u.part_string.ch_len);
+    }
+    else
+    {
+        if (ujson_mbuf_init(&buffer) != 0)
+        {
+            return -1;
+        }
+        decoded = NULL;
+        if (ujson_string_decode(&p, &len, &buffer, &ch_len, NULL) == 0)
+        {
+            decoded = ujson_new_string2(ujson_mbuf_body(&buffer),
+                                        ujson_mbuf_size(&buffer), ch_len);
+        }
+        ujson_mbuf_uninit(&buffer);
+    }
+    if (decoded == NULL)
+    {
+        return -1;
+    }
+    /* Take over the decoded body and drop the temporary node */
+    ujson->u.part_string.s = decoded->u.part_string.s;
+    ujson->u.part_string.len = decoded->u.part_string.len;
+    ujson->u.part_string.ch_len = decoded->u.part_string.ch_len;
+    ujson->u.part_string.lazy = 0;
+    decoded->u.part_string.s = NULL;
+    ujson_destroy_value(decoded);
+    return 0;
+}
+
+typedef enum
+{
+    UJSON_PARSE_IN_ARRAY_STATE_INIT = 0,
+    UJSON_PARSE_IN_ARRAY_STATE_VALUE,
+    UJSON_PARSE_IN_ARRAY_STATE_COMMA,
+    UJSON_PARSE_IN_ARRAY_STATE_FINISH,
+} ujson_parse_in_array_state_t;
+
+static ujson_t* ujson_parse_in_array(ujson_parse_ctx_t* ctx, char** p_io,
+                                     ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* new_array = NULL;
+    ujson_t* new_element = NULL;
+    ujson_array_item_t* new_element_item = NULL;
+    ujson_parse_in_array_state_t state = UJSON_PARSE_IN_ARRAY_STATE_INIT;
+    if ((new_array = ujson_new_array()) == NULL)
+    {
+        return NULL;
+    }
+    UJSON_SDT(ctx->depth++; ujson_sdt_reach(&ctx->max_depth, ctx->depth));
+    UJSON_PROBE2(parse__array__start, ctx->depth, len);
+    /* Skip '[' */
+    p++;
+    len--;
+    while ((len != 0) && (state != UJSON_PARSE_IN_ARRAY_STATE_FINISH))
+    {
+        switch (state)
+        {
+        case UJSON_PARSE_IN_ARRAY_STATE_INIT:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p == ']')
+            {
+                state = UJSON_PARSE_IN_ARRAY_STATE_FINISH;
+            }
+            else
+            {
+                if ((new_element = ujson_parse_in(ctx, &p, &len)) == NULL)
+                {
+                    goto fail;
+                }
+                if ((new_element_item = ujson_array_item_new(new_element)) ==
+                    NULL)
+                {
+                    goto fail;
+                }
+                new_element = NULL;
+                ujson_array_push_back(new_array, new_element_item);
+                new_element_item = NULL;
+                state = UJSON_PARSE_IN_ARRAY_STATE_VALUE;
+            }
+            break;
+        case UJSON_PARSE_IN_ARRAY_STATE_VALUE:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p == ']')
+            {
+                state = UJSON_PARSE_IN_ARRAY_STATE_FINISH;
+            }
+            else if (*p == ',')
+            {
+                p++;
+                len--;
+                state = UJSON_PARSE_IN_ARRAY_STATE_COMMA;
+            }
+            else
+            {
+                goto fail;
+            }
+            break;
+        case UJSON_PARSE_IN_ARRAY_STATE_COMMA:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if ((new_element = ujson_parse_in(ctx, &p, &len)) == NULL)
+            {
+                goto fail;
+            }
+            if ((new_element_item = ujson_array_item_new(new_element)) == NULL)
+            {
+                goto fail;
+            }
+            new_element = NULL;
+            ujson_array_push_back(new_array, new_element_item);
+            new_element_item = NULL;
+            state = UJSON_PARSE_IN_ARRAY_STATE_VALUE;
+            break;
+        case UJSON_PARSE_IN_ARRAY_STATE_FINISH:
+            break;
+        }
+    }
+    if (state != UJSON_PARSE_IN_ARRAY_STATE_FINISH)
+    {
+        /* Input ended before ']' */
+        goto fail;
+    }
+    /* Skip ']' */
+    p++;
+    len--;
+    *p_io = p;
+    *len_io = len;
+    goto done;
+fail:
+    if (new_array != NULL)
+    {
+        ujson_destroy_value(new_array);
+        new_array = NULL;
+    }
+    if (new_element != NULL)
+    {
+        ujson_destroy_value(new_element);
+    }
+done:
+    UJSON_PROBE2(parse__array__done, ctx->depth,
+                 (new_array != NULL) ? new_array->u.part_array.size : 0);
+    UJSON_SDT(ctx->depth--);
+    return new_array;
+}
+
+typedef enum
+{
+    UJSON_PARSE_IN_OBJECT_STATE_INIT = 0,
+    UJSON_PARSE_IN_OBJECT_STATE_KEY,
+    UJSON_PARSE_IN_OBJECT_STATE_COLON,
+    UJSON_PARSE_IN_OBJECT_STATE_VALUE,
+    UJSON_PARSE_IN_OBJECT_STATE_COMMA,
+    UJSON_PARSE_IN_OBJECT_STATE_FINISH,
+} ujson_parse_in_object_state_t;
+
+static ujson_t* ujson_parse_in_object(ujson_parse_ctx_t* ctx, char** p_io,
+                                      ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* new_array = NULL;
+    ujson_t* new_key = NULL;
+    ujson_t* new_value = NULL;
+    ujson_object_item_t* new_element_item = NULL;
+    ujson_parse_in_object_state_t state = UJSON_PARSE_IN_OBJECT_STATE_INIT;
+    if ((new_array = ujson_new_object()) == NULL)
+    {
+        return NULL;
+    }
+    UJSON_SDT(ctx->depth++; ujson_sdt_reach(&ctx->max_depth, ctx->depth));
+    UJSON_PROBE2(parse__object__start, ctx->depth, len);
+    /* Skip '{' */
+    p++;
+    len--;
+    while ((len != 0) && (state != UJSON_PARSE_IN_OBJECT_STATE_FINISH))
+    {
+        switch (state)
+        {
+        case UJSON_PARSE_IN_OBJECT_STATE_INIT:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p == '}')
+            {
+                state = UJSON_PARSE_IN_OBJECT_STATE_FINISH;
+            }
+            else
+            {
+                /* Keys are always decoded up front */
+                if ((*p != '"') ||
+                    ((new_key = ujson_parse_in_string(&p, &len)) == NULL))
+                {
+                    goto fail;
+                }
+                state = UJSON_PARSE_IN_OBJECT_STATE_KEY;
+            }
+            break;
+        case UJSON_PARSE_IN_OBJECT_STATE_KEY:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p != ':')
+            {
+                goto fail;
+            }
+            p++;
+            len--;
+            state = UJSON_PARSE_IN_OBJECT_STATE_COLON;
+            break;
+        case UJSON_PARSE_IN_OBJECT_STATE_COLON:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if ((new_value = ujson_parse_in(ctx, &p, &len)) == NULL)
+            {
+                goto fail;
+            }
+            if ((new_element_item =
+                     ujson_object_item_new(new_key, new_value)) == NULL)
+            {
+                goto fail;
+            }
+            new_key = NULL;
+            new_value = NULL;
+            ujson_object_push_back(new_array, new_element_item);
+            new_element_item = NULL;
+            state = UJSON_PARSE_IN_OBJECT_STATE_VALUE;
+            break;
+        case UJSON_PARSE_IN_OBJECT_STATE_VALUE:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p == '}')
+            {
+                state = UJSON_PARSE_IN_OBJECT_STATE_FINISH;
+            }
+            else if (*p == ',')
+            {
+                state = UJSON_PARSE_IN_OBJECT_STATE_COMMA;
+                p++;
+                len--;
+            }
+            else
+            {
+                goto fail;
+            }
+            break;
+        case UJSON_PARSE_IN_OBJECT_STATE_COMMA:
+            ujson_parse_skip_whitespace(ctx, &p, &len);
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if ((*p != '"') ||
+                ((new_key = ujson_parse_in_string(&p, &len)) == NULL))
+            {
+                goto fail;
+            }
+            state = UJSON_PARSE_IN_OBJECT_STATE_KEY;
+            break;
+        case UJSON_PARSE_IN_OBJECT_STATE_FINISH:
+            break;
+        }
+    }
+    if (state != UJSON_PARSE_IN_OBJECT_STATE_FINISH)
+    {
+        /* Input ended before '}' */
+        goto fail;
+    }
+    /* Skip '}' */
+    p++;
+    len--;
+    *p_io = p;
+    *len_io = len;
+    goto done;
+fail:
+    if (new_array != NULL)
+    {
+        ujson_destroy_value(new_array);
+        new_array = NULL;
+    }
+    if (new_key != NULL)
+    {
+        ujson_destroy_value(new_key);
+    }
+    if (new_value != NULL)
+    {
+        ujson_destroy_value(new_value);
+    }
+done:
+    UJSON_PROBE2(parse__object__done, ctx->depth,
+                 (new_array != NULL) ? new_array->u.part_object.size : 0);
+    UJSON_SDT(ctx->depth--);
+    return new_array;
+}
+
+static ujson_t* ujson_parse_in(ujson_parse_ctx_t* ctx, char** p_io,
+                               ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* result = NULL;
+    unsigned char char_class;
+    ujson_size_t literal_len;
+    /* Skip whitespace */
+    ujson_parse_skip_whitespace(ctx, &p, &len);
+    if (len == 0)
+    {
+        return NULL;
+    }
+    char_class = UJSON_CHAR_CLASS(*p);
+    switch (char_class)
+    {
+    case UJSON_CHAR_NUMBER:
+        result = ujson_parse_in_number(ctx, &p, &len);
+        break;
+    case UJSON_CHAR_STRING:
+        if (ctx->config->lazy_string == ujson_true)
+        {
+            result = ujson_parse_in_string_lazy(ctx, &p, &len);
+        }
+        else
+        {
+            result = ujson_parse_in_string(&p, &len);
+        }
+        break;
+    case UJSON_CHAR_ARRAY:
+        result = ujson_parse_in_array(ctx, &p, &len);
+        break;
+    case UJSON_CHAR_OBJECT:
+        result = ujson_parse_in_object(ctx, &p, &len);
+        break;
+    case UJSON_CHAR_NULL:
+    case UJSON_CHAR_TRUE:
+    case UJSON_CHAR_FALSE:
+    case UJSON_CHAR_UNDEFINED:
+        if ((literal_len = ujson_match_literal(p, len, char_class)) == 0)
+        {
+            break;
+        }
+        if (char_class == UJSON_CHAR_NULL)
+        {
+            result = ujson_new(UJSON_NULL);
+        }
+        else if (char_class == UJSON_CHAR_UNDEFINED)
+        {
+            result = ujson_new(UJSON_UNDEFINED);
+        }
+        else
+        {
+            result = ujson_new_bool((char_class == UJSON_CHAR_TRUE)
+                                        ? ujson_true
+                                        : ujson_false);
+        }
+        p += literal_len;
+        len -= literal_len;
+        break;
+    default:
+        break;
+    }
+#if defined(UJSON_ENABLE_SDT)
+    if (result != NULL)
+    {
+        ctx->nodes++;
+    }
+#endif
+    *p_io = p;
+    *len_io = len;
+    return result;
+}
+
+static void ujson_parse_ctx_init(ujson_parse_ctx_t* ctx,
+                                 const ujson_parse_config_t* config)
+{
+    ctx->config = config;
+    UJSON_SDT(ctx->nodes = 0; ctx->depth = 0; ctx->max_depth = 0);
+}
+
+static void ujson_parse_config_init(ujson_parse_config_t* config)
+{
+    config->lazy_number = ujson_false;
+    config->lazy_string = ujson_false;
+    config->threads = 1;
+    config->padded = ujson_false;
+}
+
+#if defined(UJSON_ENABLE_PTHREAD)
+
+typedef struct
+{
+    ujson_parse_ctx_t ctx;
+    char* p;
+    ujson_size_t len;
+    ujson_t* array;
+    int ret;
+} ujson_parse_worker_t;
+
+/* Parse the elements of a range cut out of an array body */
+static int ujson_parse_in_elements(ujson_parse_ctx_t* ctx, char* p,
+                                   ujson_size_t len, ujson_t* array)
+{
+    ujson_t* new_element;
+    ujson_array_item_t* new_element_item;
+    for (;;)
+    {
+        if ((new_element = ujson_parse_in(ctx, &p, &len)) == NULL)
+        {
+            return -1;
+        }
+        if ((new_element_item = ujson_array_item_new(new_element)) == NULL)
+        {
+            ujson_destroy_value(new_element);
+            return -1;
+        }
+        ujson_array_push_back(array, new_element_item);
+        ujson_parse_skip_whitespace(ctx, &p, &len);
+        if (len == 0)
+        {
+            return 0;
+        }
+        if (*p != ',')
+        {
+            return -1;
+        }
+        p++;
+        len--;
+    }
+}
+
+static void* ujson_parse_worker_main(void* data)
+{
+    ujson_parse_worker_t* worker = (ujson_parse_worker_t*)data;
+    worker->ret = ujson_parse_in_elements(&worker->ctx, worker->p,
+                                          worker->len, worker->array);
+    return NULL;
+}
+
+/* Structural pre-scan of an array body: find its closing ']' and the
+ * top-level commas closest past every chunk_size bytes */
+static int ujson_parse_parallel_split(char* p, ujson_size_t len,
+                                      ujson_size_t chunk_size, char** cuts,
+                                      ujson_size_t* cuts_count,
+                                      ujson_size_t cuts_max, char** end_out)
+{
+    char* p_end = p + len;
+    char* target = p + chunk_size;
+    ujson_size_t depth = 0;
+    *cuts_count = 0;
+    while (p != p_end)
+    {
+        switch (*p)
+        {
+        case '"':
+            /* Skip the string */
+            p++;
+            while ((p != p_end) && (*p != '"'))
+            {
+                if ((*p == '\\') && (++p == p_end))
+                {
+                    return -1;
+                }
+                p++;
+            }
+            if (p == p_end)
+            {
+                return -1;
+            }
+            break;
+        case '[':
+        case '{':
+            depth++;
+            break;
+        case ']':
+        case '}':
+            if (depth == 0)
+            {
+                *end_out = p;
+                return (*p == ']') ? 0 : -1;
+            }
+            depth--;
+            break;
+        case ',':
+            if ((depth == 0) && (p >= target) && (*cuts_count < cuts_max))
+            {
+                cuts[(*cuts_count)++] = p;
+                target = p + chunk_size;
+            }
+            break;
+        default:
+            break;
+        }
+        p++;
+    }
+    return -1;
+}
+
+static ujson_t* ujson_parse_in_array_parallel(ujson_parse_ctx_t* ctx,
+                                              char** p_io,
+                                              ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_size_t threads = (ujson_size_t)ctx->config->threads;
+    ujson_parse_worker_t* workers = NULL;
+    pthread_t* tids = NULL;
+    ujson_bool* started = NULL;
+    char** cuts = NULL;
+    ujson_size_t cuts_count = 0;
+    char* body;
+    char* end;
+    ujson_t* result = NULL;
+    ujson_t* segment;
+    ujson_size_t i;
+
+    /* Small inputs are not worth the threads */
+    if (threads > len / UJSON_PARSE_PARALLEL_MIN_CHUNK)
+    {
+        threads = len / UJSON_PARSE_PARALLEL_MIN_CHUNK;
+    }
+    if (threads < 2)
+    {
+        return ujson_parse_in_array(ctx, p_io, len_io);
+    }
+
+    if ((workers = (ujson_parse_worker_t*)ujson_malloc(
+             sizeof(ujson_parse_worker_t) * threads)) == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i != threads; i++)
+    {
+        workers[i].array = NULL;
+    }
+    if (((tids = (pthread_t*)ujson_malloc(sizeof(pthread_t) * threads)) ==
+         NULL) ||
+        ((started = (ujson_bool*)ujson_malloc(sizeof(ujson_bool) * threads)) ==
+         NULL) ||
+        ((cuts = (char**)ujson_malloc(sizeof(char*) * threads)) == NULL))
+    {
+        goto done;
+    }
+    for (i = 0; i != threads; i++)
+    {
+        started[i] = ujson_false;
+    }
+
+    /* Skip '[' */
+    body = p + 1;
+    if (ujson_parse_parallel_split(body, len - 1, (len - 1) / threads, cuts,
+                                   &cuts_count, threads - 1, &end) != 0)
+    {
+        goto done;
+    }
+    p = body;
+    len = (ujson_size_t)(end - body);
+    ujson_skip_whitespace(&p, &len);
+    if (len == 0)
+    {
+        result = ujson_new_array();
+        goto finish;
+    }
+
+    /* Element ranges between the cuts, each parsed on its own thread */
+    threads = cuts_count + 1;
+    for (i = 0; i != threads; i++)
+    {
+        workers[i].ctx = *ctx;
+        /* Workers count the elements, one level below the array */
+        UJSON_SDT(workers[i].ctx.nodes = 0;
+                  workers[i].ctx.depth = ctx->depth + 1);
+        workers[i].p = (i == 0) ? body : cuts[i - 1] + 1;
+        workers[i].len =
+            (ujson_size_t)(((i == cuts_count) ? end : cuts[i]) - workers[i].p);
+        workers[i].ret = -1;
+        if ((workers[i].array = ujson_new_array()) == NULL)
+        {
+            goto done;
+        }
+    }
+    for (i = 1; i != threads; i++)
+    {
+        if (pthread_create(&tids[i], NULL, ujson_parse_worker_main,
+                           &workers[i]) == 0)
+        {
+            started[i] = ujson_true;
+        }
+    }
+    ujson_parse_worker_main(&workers[0]);
+    for (i = 1; i != threads; i++)
+    {
+        if (started[i] == ujson_true)
+        {
+            pthread_join(tids[i], NULL);
+        }
+        else
+        {
+            ujson_parse_worker_main(&workers[i]);
+        }
+    }
+    for (i = 0; i != threads; i++)
+    {
+        if (workers[i].ret != 0)
+        {
+            goto done;
+        }
+    }
+
+#if defined(UJSON_ENABLE_SDT)
+    for (i = 0; i != threads; i++)
+    {
+        ctx->nodes += workers[i].ctx.nodes;
+        if (workers[i].ctx.max_depth > ctx->max_depth)
+        {
+            ctx->max_depth = workers[i].ctx.max_depth;
+        }
+    }
+#endif
+
+    /* Stitch the segments into the first one */
+    result = workers[0].array;
+    workers[0].array = NULL;
+    for (i = 1; i != threads; i++)
+    {
+        segment = workers[i].array;
+        if (segment->u.part_array.begin != NULL)
+        {
+            if (result->u.part_array.begin == NULL)
+            {
+                result->u.part_array.begin = segment->u.part_array.begin;
+            }
+            else
+            {
+                result->u.part_array.end->next = segment->u.part_array.begin;
+                segment->u.part_array.begin->prev = result->u.part_array.end;
+            }
+            result->u.part_array.end = segment->u.part_array.end;
+            result->u.part_array.size += segment->u.part_array.size;
+            segment->u.part_array.begin = NULL;
+        }
+    }
+    ujson_reparent(result);
+finish:
+    if (result != NULL)
+    {
+#if defined(UJSON_ENABLE_SDT)
+        ctx->nodes++;
+        if (ctx->max_depth <= ctx->depth)
+        {
+            ctx->max_depth = ctx->depth + 1;
+        }
+#endif
+        /* Skip ']' */
+        *len_io -= (ujson_size_t)(end + 1 - *p_io);
+        *p_io = end + 1;
+    }
+done:
+    for (i = 0; i != threads; i++)
+    {
+        if (workers[i].array != NULL)
+        {
+            ujson_destroy_value(workers[i].array);
+        }
+    }
+    ujson_free(workers);
+    if (tids != NULL)
+        ujson_free(tids);
+    if (started != NULL)
+        ujson_free(started);
+    if (cuts != NULL)
+        ujson_free(cuts);
+    return result;
+}
+
+#endif
+
+/* Parse a JSON string and generate a JSON value (with config) */
+ujson_t* ujson_parse_ex(char* s, ujson_size_t len,
+                        ujson_parse_config_t* config)
+{
+    ujson_parse_ctx_t ctx;
+    ujson_t* result;
+#if defined(UJSON_ENABLE_PTHREAD)
+    ujson_parse_config_t unpadded;
+#endif
+    ujson_parse_ctx_init(&ctx, config);
+    UJSON_PROBE2(parse__start, s, len);
+#if defined(UJSON_ENABLE_PTHREAD)
+    if (config->threads > 1)
+    {
+        ujson_skip_whitespace(&s, &len);
+        if ((len != 0) && (*s == '['))
+        {
+            /* The ranges cut out for the workers are not padded */
+            unpadded = *config;
+            unpadded.padded = ujson_false;
+            ctx.config = &unpadded;
+            result = ujson_parse_in_array_parallel(&ctx, &s, &len);
+            goto done;
+        }
+    }
+#endif
+    result = ujson_parse_in(&ctx, &s, &len);
+#if defined(UJSON_ENABLE_PTHREAD)
+done:
+#endif
+    UJSON_PROBE3(parse__done, result, ctx.nodes, ctx.max_depth);
+    return result;
+}
+
+/* Parse a JSON string and generate a JSON value */
+ujson_t* ujson_parse(char* s, ujson_size_t len)
+{
+    ujson_parse_config_t config;
+    ujson_parse_config_init(&config);
+    return ujson_parse_ex(s, len, &config);
+}
+
+/* Parse a JSON string followed by UJSON_PADDING zero bytes */
+ujson_t* ujson_parse_padded(char* s, ujson_size_t len)
+{
+    ujson_parse_config_t config;
+    ujson_parse_config_init(&config);
+    config.padded = ujson_true;
+    return ujson_parse_ex(s, len, &config);
+}
+
+/* Skip a value without building it */
+
+static int ujson_skip_value(char** p_io, ujson_size_t* len_io);
+
+static int ujson_skip_container(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    char close = (*p == '[') ? ']' : '}';
+    ujson_bool escaped;
+    /* Skip '[' or '{' */
+    p++;
+    len--;
+    ujson_skip_whitespace(&p, &len);
+    if ((len != 0) && (*p == close))
+    {
+        goto finish;
+    }
+    for (;;)
+    {
+        if (close == '}')
+        {
+            if ((len == 0) || (*p != '"') ||
+                (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0))
+            {
+                return -1;
+            }
+            ujson_skip_whitespace(&p, &len);
+            if ((len == 0) || (*p != ':'))
+            {
+                return -1;
+            }
+            p++;
+            len--;
+        }
+        if (ujson_skip_value(&p, &len) != 0)
+        {
+            return -1;
+        }
+        ujson_skip_whitespace(&p, &len);
+        if (len == 0)
+        {
+            return -1;
+        }
+        if (*p == close)
+        {
+            break;
+        }
+        if (*p != ',')
+        {
+            return -1;
+        }
+        p++;
+        len--;
+        ujson_skip_whitespace(&p, &len);
+    }
+finish:
+    /* Skip ']' or '}' */
+    p++;
+    len--;
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+static int ujson_skip_value(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_bool escaped;
+    unsigned char char_class;
+    ujson_size_t literal_len;
+    ujson_skip_whitespace(&p, &len);
+    if (len == 0)
+    {
+        return -1;
+    }
+    char_class = UJSON_CHAR_CLASS(*p);
+    switch (char_class)
+    {
+    case UJSON_CHAR_NUMBER:
+        if (ujson_skip_number(&p, &len, ujson_false) != 0)
+        {
+            return -1;
+        }
+        break;
+    case UJSON_CHAR_STRING:
+        if (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0)
+        {
+            return -1;
+        }
+        break;
+    case UJSON_CHAR_ARRAY:
+    case UJSON_CHAR_OBJECT:
+        if (ujson_skip_container(&p, &len) != 0)
+        {
+            return -1;
+        }
+        break;
+    default:
+        if ((literal_len = ujson_match_literal(p, len, char_class)) == 0)
+        {
+            return -1;
+        }
+        p += literal_len;
+        len -= literal_len;
+        break;
+    }
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+/* Validation */
+
+/* Token scanners keep one bit per open container, set for objects, so
+ * nesting costs no allocation */
+#define UJSON_SCAN_MAX_DEPTH 1024
+
+static void ujson_scan_push(unsigned char* stack, ujson_size_t depth,
+                            ujson_bool is_object)
+{
+    if (is_object == ujson_true)
+    {
+        stack[depth / 8] |= (unsigned char)(1 << (depth % 8));
+    }
+    else
+    {
+        stack[depth / 8] &= (unsigned char)~(1 << (depth % 8));
+    }
+}
+
+static ujson_bool ujson_scan_in_object(const unsigned char* stack,
+                                       ujson_size_t depth)
+{
+    if ((depth == 0) ||
+        ((stack[(depth - 1) / 8] & (1 << ((depth - 1) % 8))) == 0))
+    {
+        return ujson_false;
+    }
+    return ujson_true;
+}
+
+/* Length of the well-formed UTF-8 sequence at p, 0 if it is not one;
+ * overlong forms, surrogates and code points past U+10FFFF are rejected */
+static ujson_size_t ujson_utf8_sequence_length(const char* s,
+                                               ujson_size_t len)
+{
+    const unsigned char* p = (const unsigned char*)s;
+    ujson_size_t bytes_number;
+    ujson_size_t i;
+    /* 0xxxxxxx */
+    if (p[0] < 0x80)
+    {
+        return 1;
+    }
+    /* 110xxxxx, 10xxxxxx (0xc0 and 0xc1 would be overlong) */
+    else if ((0xc2 <= p[0]) && (p[0] <= 0xdf))
+    {
+        bytes_number = 2;
+    }
+    /* 1110xxxx, 10xxxxxx, 10xxxxxx */
+    else if ((0xe0 <= p[0]) && (p[0] <= 0xef))
+    {
+        bytes_number = 3;
+    }
+    /* 11110xxx, 10xxxxxx, 10xxxxxx, 10xxxxxx */
+    else if ((0xf0 <= p[0]) && (p[0] <= 0xf4))
+    {
+        bytes_number = 4;
+    }
+    else
+    {
+        return 0;
+    }
+    if (len < bytes_number)
+    {
+        return 0;
+    }
+    for (i = 1; i != bytes_number; i++)
+    {
+        if ((p[i] & 0xc0) != 0x80)
         {
-            value = value * 10 + ((*p) - '0');
-            p++;
-            len--;
+            return 0;
         }
     }
-    else
+    /* Overlong, surrogate and out of range second bytes */
+    if (((p[0] == 0xe0) && (p[1] < 0xa0)) ||
+        ((p[0] == 0xed) && (p[1] > 0x9f)) ||
+        ((p[0] == 0xf0) && (p[1] < 0x90)) ||
+        ((p[0] == 0xf4) && (p[1] > 0x8f)))
     {
-        return NULL;
+        return 0;
     }
-    /* Fill double part */
-    value_double = (double)value;
-    /* Fractal Part */
+    return bytes_number;
+}
+
+/* The validators leave p at the offending byte when they fail */
+static int ujson_validate_string(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_size_t run;
+    unsigned long word;
+    int ret = -1;
+    /* Skip '"' */
+    p++;
+    len--;
+    for (;;)
+    {
+        /* Plain ASCII a word at a time */
+        while (len >= sizeof(unsigned long))
+        {
+            word = ujson_load_long(p);
+            if (UJSON_SWAR_STRING_STOP(word) != 0)
+            {
+                break;
+            }
+            p += sizeof(unsigned long);
+            len -= sizeof(unsigned long);
+        }
+        if (len == 0)
+        {
+            goto fail;
+        }
+        if (*p == '"')
+        {
+            break;
+        }
+        else if (*p == '\\')
+        {
+            if (len < 2)
+            {
+                goto fail;
+            }
+            switch (*(p + 1))
+            {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                run = 2;
+                break;
+            case 'u':
+                if ((len < 6) || (!ISHEXDIGIT_S4(p + 2)))
+                {
+                    goto fail;
+                }
+                run = 6;
+                break;
+            default:
+                goto fail;
+            }
+        }
+        else if ((unsigned char)*p < 0x20)
+        {
+            goto fail;
+        }
+        else if ((run = ujson_utf8_sequence_length(p, len)) == 0)
+        {
+            goto fail;
+        }
+        p += run;
+        len -= run;
+    }
+    /* Skip '"' */
+    p++;
+    len--;
+    ret = 0;
+fail:
+    *p_io = p;
+    *len_io = len;
+    return ret;
+}
+
+static int ujson_validate_number(char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_size_t run;
+    int ret = -1;
+    if (*p == '-')
+    {
+        p++;
+        len--;
+    }
+    if ((len == 0) || (!ISDIGIT(*p)))
+    {
+        goto fail;
+    }
+    run = (*p == '0') ? 1 : ujson_span_digits(p, len, ujson_false);
+    p += run;
+    len -= run;
     if ((len > 0) && (*p == '.'))
     {
-        /* Skip '.' */
         p++;
         len--;
-        base = 0.1;
-        while ((len > 0) && (ISDIGIT(*p)))
+        if ((run = ujson_span_digits(p, len, ujson_false)) == 0)
         {
-            value_double += base * ((*p) - '0');
-            base /= 10;
-            p++;
-            len--;
+            goto fail;
         }
+        p += run;
+        len -= run;
     }
-    /* Negative */
-    if (negative == ujson_true)
+    if ((len > 0) && ((*p == 'e') || (*p == 'E')))
     {
-        value = -value;
-        value_double = -value_double;
+        p++;
+        len--;
+        if ((len > 0) && ((*p == '+') || (*p == '-')))
+        {
+            p++;
+            len--;
+        }
+        if ((run = ujson_span_digits(p, len, ujson_false)) == 0)
+        {
+            goto fail;
+        }
+        p += run;
+        len -= run;
     }
-    result = ujson_new_number(value, value_double);
+    ret = 0;
+fail:
     *p_io = p;
     *len_io = len;
-    return result;
+    return ret;
 }
 
-static ujson_t* ujson_parse_in_string(char** p_io, ujson_size_t* len_io)
+typedef enum
 {
-    char* p = *p_io;
-    ujson_size_t len = *len_io;
-    ujson_t* result = NULL;
-    ujson_mbuf_t buffer;
-    ujson_parse_in_string_state_t state = UJSON_PARSE_IN_STRING_STATE_INIT;
-    ujson_size_t bytes_number;
-    ujson_size_t ch_len = 0;
-    int value_u;
-    char writebuf[7];
-    /* Initialize buffer */
-    ujson_mbuf_init(&buffer);
-    /* Skip '"' */
-    p++;
-    len--;
-    while (len > 0)
+    UJSON_SCAN_STATE_VALUE,
+    UJSON_SCAN_STATE_KEY,
+    UJSON_SCAN_STATE_NEXT,
+} ujson_scan_state_t;
+
+/* Check grammar (RFC 8259) and UTF-8 without building anything */
+int ujson_validate(char* s, ujson_size_t len, ujson_size_t* err_offset)
+{
+    char* p = s;
+    ujson_scan_state_t state = UJSON_SCAN_STATE_VALUE;
+    unsigned char stack[UJSON_SCAN_MAX_DEPTH / 8];
+    ujson_size_t depth = 0;
+    ujson_bool in_object;
+    unsigned char char_class;
+    ujson_size_t literal_len;
+
+    for (;;)
     {
+        ujson_skip_whitespace(&p, &len);
+        in_object = ujson_scan_in_object(stack, depth);
         switch (state)
         {
-        case UJSON_PARSE_IN_STRING_STATE_INIT:
-            if (*p == '"')
+        case UJSON_SCAN_STATE_VALUE:
+            if (len == 0)
             {
-                goto finish;
+                goto fail;
+            }
+            char_class = UJSON_CHAR_CLASS(*p);
+            switch (char_class)
+            {
+            case UJSON_CHAR_NUMBER:
+                if (ujson_validate_number(&p, &len) != 0)
+                {
+                    goto fail;
+                }
+                break;
+            case UJSON_CHAR_STRING:
+                if (ujson_validate_string(&p, &len) != 0)
+                {
+                    goto fail;
+                }
+                break;
+            case UJSON_CHAR_ARRAY:
+            case UJSON_CHAR_OBJECT:
+                if (depth == UJSON_SCAN_MAX_DEPTH)
+                {
+                    goto fail;
+                }
+                ujson_scan_push(stack, depth++,
+                                (char_class == UJSON_CHAR_OBJECT) ? ujson_true
+                                                                  : ujson_false);
+                /* Skip '[' or '{' */
+                p++;
+                len--;
+                ujson_skip_whitespace(&p, &len);
+                if ((len != 0) &&
+                    (*p == ((char_class == UJSON_CHAR_OBJECT) ? '}' : ']')))
+                {
+                    break;
+                }
+                state = (char_class == UJSON_CHAR_OBJECT)
+                            ? UJSON_SCAN_STATE_KEY
+                            : UJSON_SCAN_STATE_VALUE;
+                continue;
+            case UJSON_CHAR_NULL:
+            case UJSON_CHAR_TRUE:
+            case UJSON_CHAR_FALSE:
+                if ((literal_len = ujson_match_literal(p, len, char_class)) ==
+                    0)
+                {
+                    goto fail;
+                }
+                p += literal_len;
+                len -= literal_len;
+                break;
+            default:
+                goto fail;
+            }
+            state = UJSON_SCAN_STATE_NEXT;
+            break;
+        case UJSON_SCAN_STATE_KEY:
+            if ((len == 0) || (*p != '"') ||
+                (ujson_validate_string(&p, &len) != 0))
+            {
+                goto fail;
+            }
+            ujson_skip_whitespace(&p, &len);
+            if ((len == 0) || (*p != ':'))
+            {
+                goto fail;
+            }
+            p++;
+            len--;
+            state = UJSON_SCAN_STATE_VALUE;
+            break;
+        case UJSON_SCAN_STATE_NEXT:
+            if (depth == 0)
+            {
+                /* Nothing but whitespace after the root */
+                if (len != 0)
+                {
+                    goto fail;
+                }
+                return 0;
+            }
+            if (len == 0)
+            {
+                goto fail;
+            }
+            if (*p == ',')
+            {
+                p++;
+                len--;
+                state = (in_object == ujson_true) ? UJSON_SCAN_STATE_KEY
+                                                  : UJSON_SCAN_STATE_VALUE;
+            }
+            else if (*p == ((in_object == ujson_true) ? '}' : ']'))
+            {
+                p++;
+                len--;
+                depth--;
+            }
+            else
+            {
+                goto fail;
+            }
+            break;
+        }
+    }
+fail:
+    if (err_offset != NULL)
+    {
+        *err_offset = (ujson_size_t)(p - s);
+    }
+    return -1;
+}
+
+/* Streaming reformat */
+
+#define UJSON_WRITER_BUFFER_SIZE 4096
+#define UJSON_INDENT_BUFFER_SIZE 128
+
+/* Output is gathered in a fixed buffer and handed out in large writes */
+typedef struct
+{
+    ujson_write_cb_t write;
+    void* data;
+    ujson_size_t size;
+    char buf[UJSON_WRITER_BUFFER_SIZE];
+} ujson_writer_t;
+
+static int ujson_writer_flush(ujson_writer_t* writer)
+{
+    ujson_size_t size = writer->size;
+    writer->size = 0;
+    if ((size != 0) && (writer->write(writer->data, writer->buf, size) != 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int ujson_writer_append(ujson_writer_t* writer, const char* s,
+                               ujson_size_t len)
+{
+    if (writer->size + len > UJSON_WRITER_BUFFER_SIZE)
+    {
+        if (ujson_writer_flush(writer) != 0)
+        {
+            return -1;
+        }
+        /* Long tokens go out directly */
+        if (len >= UJSON_WRITER_BUFFER_SIZE)
+        {
+            return writer->write(writer->data, s, len);
+        }
+    }
+    ujson_memcpy(writer->buf + writer->size, s, len);
+    writer->size += len;
+    return 0;
+}
+
+/* A line break and width replacer characters, taken from a buffer that
+ * holds a newline and UJSON_INDENT_BUFFER_SIZE replacers */
+static int ujson_writer_newline(ujson_writer_t* writer, const char* indent,
+                                ujson_size_t width)
+{
+    ujson_size_t run =
+        (width < UJSON_INDENT_BUFFER_SIZE) ? width : UJSON_INDENT_BUFFER_SIZE;
+    if (ujson_writer_append(writer, indent, run + 1) != 0)
+    {
+        return -1;
+    }
+    for (width -= run; width != 0; width -= run)
+    {
+        run = (width < UJSON_INDENT_BUFFER_SIZE) ? width
+                                                 : UJSON_INDENT_BUFFER_SIZE;
+        if (ujson_writer_append(writer, indent + 1, run) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Rewrite the whitespace of a JSON string token by token; strings and
+ * numbers are copied as they are */
+int ujson_reformat(char* s, ujson_size_t len,
+                   const ujson_stringify_config_t* config,
+                   ujson_write_cb_t write, void* data)
+{
+    char* p = s;
+    ujson_scan_state_t state = UJSON_SCAN_STATE_VALUE;
+    unsigned char stack[UJSON_SCAN_MAX_DEPTH / 8];
+    ujson_size_t depth = 0;
+    ujson_bool in_object;
+    ujson_bool pretty;
+    ujson_size_t repeat;
+    ujson_writer_t writer;
+    char indent[1 + UJSON_INDENT_BUFFER_SIZE];
+    char* start;
+    char close;
+    unsigned char char_class;
+    ujson_size_t literal_len;
+    ujson_bool escaped;
+    ujson_size_t i;
+
+    writer.write = write;
+    writer.data = data;
+    writer.size = 0;
+    pretty = (config->style == UJSON_STRINGIFY_CONFIG_STYLE_INDENT)
+                 ? ujson_true
+                 : ujson_false;
+    repeat = (config->repeat > 0) ? (ujson_size_t)config->repeat : 0;
+    indent[0] = '\n';
+    for (i = 1; i != sizeof(indent); i++)
+    {
+        indent[i] = config->replacer;
+    }
+
+    for (;;)
+    {
+        ujson_skip_whitespace(&p, &len);
+        in_object = ujson_scan_in_object(stack, depth);
+        switch (state)
+        {
+        case UJSON_SCAN_STATE_VALUE:
+            if (len == 0)
+            {
+                return -1;
             }
-            else if (*p == '\\')
+            start = p;
+            char_class = UJSON_CHAR_CLASS(*p);
+            switch (char_class)
             {
-                if ((len < 2))
+            case UJSON_CHAR_NUMBER:
+                if (ujson_skip_number(&p, &len, ujson_false) != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
-                state = UJSON_PARSE_IN_STRING_STATE_ESCAPE;
+                break;
+            case UJSON_CHAR_STRING:
+                if (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0)
+                {
+                    return -1;
+                }
+                break;
+            case UJSON_CHAR_ARRAY:
+            case UJSON_CHAR_OBJECT:
+                close = (char_class == UJSON_CHAR_OBJECT) ? '}' : ']';
+                /* Skip '[' or '{' */
                 p++;
                 len--;
-            }
-            else if (IS_HYPER_ID(*p))
-            {
-                bytes_number = id_hyper_length(*p);
-                if (len < bytes_number)
+                ujson_skip_whitespace(&p, &len);
+                if ((len != 0) && (*p == close))
                 {
-                    goto fail;
+                    /* Empty containers stay on one line */
+                    p++;
+                    len--;
+                    if ((ujson_writer_append(&writer, start, 1) != 0) ||
+                        (ujson_writer_append(&writer, &close, 1) != 0))
+                    {
+                        return -1;
+                    }
+                    state = UJSON_SCAN_STATE_NEXT;
+                    continue;
                 }
-                if (ujson_mbuf_append(&buffer, p, bytes_number) != 0)
+                if (depth == UJSON_SCAN_MAX_DEPTH)
                 {
-                    goto fail;
+                    return -1;
                 }
-                ch_len++;
-                p += bytes_number;
-                len -= bytes_number;
-            }
-            else
-            {
-                if (ujson_mbuf_append(&buffer, p, 1) != 0)
+                ujson_scan_push(stack, depth++,
+                                (char_class == UJSON_CHAR_OBJECT) ? ujson_true
+                                                                  : ujson_false);
+                if ((ujson_writer_append(&writer, start, 1) != 0) ||
+                    ((pretty == ujson_true) &&
+                     (ujson_writer_newline(&writer, indent, depth * repeat) !=
+                      0)))
                 {
-                    goto fail;
+                    return -1;
                 }
-                ch_len++;
-                p++;
-                len--;
+                state = (char_class == UJSON_CHAR_OBJECT)
+                            ? UJSON_SCAN_STATE_KEY
+                            : UJSON_SCAN_STATE_VALUE;
+                continue;
+            default:
+                if ((literal_len = ujson_match_literal(p, len, char_class)) ==
+                    0)
+                {
+                    return -1;
+                }
+                p += literal_len;
+                len -= literal_len;
+                break;
+            }
+            if (ujson_writer_append(&writer, start, (ujson_size_t)(p - start)) !=
+                0)
+            {
+                return -1;
             }
+            state = UJSON_SCAN_STATE_NEXT;
             break;
-        case UJSON_PARSE_IN_STRING_STATE_ESCAPE:
-            if (*p == '"')
+        case UJSON_SCAN_STATE_KEY:
+            start = p;
+            if ((len == 0) || (*p != '"') ||
+                (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0) ||
+                (ujson_writer_append(&writer, start,
+                                     (ujson_size_t)(p - start)) != 0))
             {
-                if (ujson_mbuf_append(&buffer, "\"", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                return -1;
             }
-            else if (*p == '\\')
+            ujson_skip_whitespace(&p, &len);
+            if ((len == 0) || (*p != ':') ||
+                (ujson_writer_append(&writer, ": ",
+                                     (pretty == ujson_true) ? 2 : 1) != 0))
             {
-                if (ujson_mbuf_append(&buffer, "\\", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                return -1;
             }
-            else if (*p == '/')
+            p++;
+            len--;
+            state = UJSON_SCAN_STATE_VALUE;
+            break;
+        case UJSON_SCAN_STATE_NEXT:
+            if (depth == 0)
             {
-                if (ujson_mbuf_append(&buffer, "/", 1) != 0)
+                /* Nothing but whitespace after the root */
+                if (len != 0)
                 {
-                    goto fail;
+                    return -1;
                 }
-                ch_len++;
-                p++;
-                len--;
+                return ujson_writer_flush(&writer);
             }
-            else if (*p == 'b')
+            if (len == 0)
             {
-                if (ujson_mbuf_append(&buffer, "\b", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                return -1;
             }
-            else if (*p == 'f')
+            close = (in_object == ujson_true) ? '}' : ']';
+            if (*p == ',')
             {
-                if (ujson_mbuf_append(&buffer, "\f", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                state = (in_object == ujson_true) ? UJSON_SCAN_STATE_KEY
+                                                  : UJSON_SCAN_STATE_VALUE;
             }
-            else if (*p == 'n')
+            else if (*p == close)
             {
-                if (ujson_mbuf_append(&buffer, "\n", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                depth--;
             }
-            else if (*p == 'r')
+            else
             {
-                if (ujson_mbuf_append(&buffer, "\r", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                return -1;
             }
-            else if (*p == 't')
+            if (((*p == close) && (pretty == ujson_true) &&
+                 (ujson_writer_newline(&writer, indent, depth * repeat) !=
+                  0)) ||
+                (ujson_writer_append(&writer, p, 1) != 0) ||
+                ((*p == ',') && (pretty == ujson_true) &&
+                 (ujson_writer_newline(&writer, indent, depth * repeat) != 0)))
             {
-                if (ujson_mbuf_append(&buffer, "\t", 1) != 0)
-                {
-                    goto fail;
-                }
-                ch_len++;
-                p++;
-                len--;
+                return -1;
             }
-            else if ((*p == 'u') && (len >= 5) && ISHEXDIGIT_S4(p + 1))
+            p++;
+            len--;
+            break;
+        }
+    }
+}
+
+/* Strip all insignificant whitespace from a JSON string */
+int ujson_minify(char* s, ujson_size_t len, ujson_write_cb_t write,
+                 void* data)
+{
+    ujson_stringify_config_t config;
+    ujson_stringify_config_init(&config);
+    return ujson_reformat(s, len, &config, write, data);
+}
+
+/* Projection */
+
+struct ujson_project
+{
+    ujson_pointer_t** paths;
+    ujson_size_t size;
+    ujson_size_t depth;
+};
+
+/* Compile one "a.b[2].c" / "tags[*]" path into pointer tokens */
+static ujson_pointer_t* ujson_project_compile_path(const char* s)
+{
+    ujson_pointer_t* ptr;
+    ujson_pointer_token_t* token;
+    char* body;
+    const char* p;
+    ujson_size_t len = 0;
+    ujson_size_t count = 0;
+    ujson_size_t index;
+
+    /* Every '.' and '[' starts a new token, plus the leading key */
+    while (s[len] != '\0')
+    {
+        if ((s[len] == '.') || (s[len] == '['))
+        {
+            count++;
+        }
+        len++;
+    }
+    if ((len != 0) && (s[0] != '['))
+    {
+        count++;
+    }
+
+    if ((ptr = (ujson_pointer_t*)ujson_malloc(
+             sizeof(ujson_pointer_t) + sizeof(ujson_pointer_token_t) * count +
+             sizeof(char) * (len + count + 1))) == NULL)
+    {
+        return NULL;
+    }
+    ptr->tokens = (ujson_pointer_token_t*)(ptr + 1);
+    ptr->size = 0;
+    body = (char*)(ptr->tokens + count);
+
+    p = s;
+    while (*p != '\0')
+    {
+        token = &ptr->tokens[ptr->size];
+        token->s = body;
+        token->len = 0;
+        token->index = 0;
+        if (*p == '[')
+        {
+            p++;
+            if ((*p == '*') && (*(p + 1) == ']'))
             {
-                value_u = ujson_parse_in_string_hexchar_to_num_s4(p + 1);
-                if (value_u == -1)
-                    goto fail;
-                if ((0 <= value_u) && (value_u <= 0x7F))
-                {
-                    writebuf[0] = ((char)value_u);
-                    if (ujson_mbuf_append(&buffer, writebuf, 1) != 0)
-                    {
-                        goto fail;
-                    }
-                    ch_len++;
-                    p += 5;
-                    len -= 5;
-                }
-                else if ((0x80 <= value_u) && (value_u <= 0x7FF))
+                token->type = UJSON_POINTER_TOKEN_ANY_INDEX;
+                p += 2;
+            }
+            else
+            {
+                if (!ISDIGIT(*p))
                 {
-                    writebuf[0] = (char)(0xc0 | (((unsigned int)value_u) >> 6));
-                    writebuf[1] =
-                        (char)(0x80 | (((unsigned int)value_u) & 0x3f));
-                    if (ujson_mbuf_append(&buffer, writebuf, 2) != 0)
-                    {
-                        goto fail;
-                    }
-                    ch_len++;
-                    p += 5;
-                    len -= 5;
+                    goto fail;
                 }
-                else if ((0x800 <= value_u) && (value_u <= 0x7FFF))
+                index = 0;
+                while (ISDIGIT(*p))
                 {
-                    writebuf[0] =
-                        (char)(0xe0 | (((unsigned int)value_u) >> 12));
-                    writebuf[1] =
-                        (char)(0x80 | (((unsigned int)value_u >> 6) & 0x3f));
-                    writebuf[2] =
-                        (char)(0x80 | (((unsigned int)value_u) & 0x3f));
-                    if (ujson_mbuf_append(&buffer, writebuf, 3) != 0)
+                    if (index > (((ujson_size_t)-1) - 9) / 10)
                     {
                         goto fail;
                     }
-                    ch_len++;
-                    p += 5;
-                    len -= 5;
+                    index = index * 10 + (ujson_size_t)(*p - '0');
+                    p++;
                 }
-                else
+                if (*p != ']')
                 {
                     goto fail;
                 }
+                p++;
+                token->type = UJSON_POINTER_TOKEN_INDEX;
+                token->index = index;
+            }
+        }
+        else
+        {
+            if ((ptr->size != 0) && (*p++ != '.'))
+            {
+                goto fail;
+            }
+            while ((*p != '\0') && (*p != '.') && (*p != '['))
+            {
+                body[token->len++] = *p++;
+            }
+            if ((token->len == 1) && (body[0] == '*'))
+            {
+                token->type = UJSON_POINTER_TOKEN_ANY_KEY;
+            }
+            else if (token->len != 0)
+            {
+                token->type = UJSON_POINTER_TOKEN_KEY;
             }
             else
             {
                 goto fail;
             }
-            /* Reset state */
-            state = UJSON_PARSE_IN_STRING_STATE_INIT;
+        }
+        body[token->len] = '\0';
+        body += token->len + 1;
+        token->hash = ujson_hash(token->s, token->len);
+        ptr->size++;
+    }
+    return ptr;
+fail:
+    ujson_free(ptr);
+    return NULL;
+}
+
+ujson_project_t* ujson_project_compile(const char** paths, ujson_size_t count)
+{
+    ujson_project_t* project;
+    ujson_size_t i;
+
+    if ((project = (ujson_project_t*)ujson_malloc(
+             sizeof(ujson_project_t) + sizeof(ujson_pointer_t*) * count)) ==
+        NULL)
+    {
+        return NULL;
+    }
+    project->paths = (ujson_pointer_t**)(project + 1);
+    project->size = 0;
+    project->depth = 0;
+    for (i = 0; i != count; i++)
+    {
+        if ((project->paths[i] = ujson_project_compile_path(paths[i])) == NULL)
+        {
+            ujson_project_destroy(project);
+            return NULL;
+        }
+        project->size++;
+        if (project->paths[i]->size > project->depth)
+        {
+            project->depth = project->paths[i]->size;
+        }
+    }
+    return project;
+}
+
+void ujson_project_destroy(ujson_project_t* project)
+{
+    ujson_size_t i;
+    for (i = 0; i != project->size; i++)
+    {
+        ujson_free(project->paths[i]);
+    }
+    ujson_free(project);
+}
+
+typedef struct
+{
+    ujson_parse_ctx_t parse;
+    const ujson_project_t* project;
+    /* Row n lists the paths whose first n tokens led to the current value */
+    ujson_size_t* alive;
+} ujson_project_ctx_t;
+
+static int ujson_parse_project_in(ujson_project_ctx_t* ctx, char** p_io,
+                                  ujson_size_t* len_io, ujson_size_t depth,
+                                  ujson_size_t alive_count,
+                                  ujson_t** result_out);
+
+/* Fill row (depth + 1) with the paths that continue through a member */
+static ujson_size_t ujson_project_match(ujson_project_ctx_t* ctx,
+                                        ujson_size_t depth,
+                                        ujson_size_t alive_count,
+                                        const char* key, ujson_size_t key_len,
+                                        ujson_size_t index)
+{
+    ujson_size_t size = ctx->project->size;
+    ujson_size_t* alive = ctx->alive + depth * size;
+    ujson_size_t* next = alive + size;
+    ujson_size_t next_count = 0;
+    ujson_pointer_token_t* token;
+    unsigned int hash = 0;
+    ujson_size_t i;
+
+    if (key != NULL)
+    {
+        hash = ujson_hash(key, key_len);
+    }
+    for (i = 0; i != alive_count; i++)
+    {
+        token = &ctx->project->paths[alive[i]]->tokens[depth];
+        if ((key != NULL)
+                ? ((token->type == UJSON_POINTER_TOKEN_ANY_KEY) ||
+                   ((token->type == UJSON_POINTER_TOKEN_KEY) &&
+                    (token->hash == hash) && (token->len == key_len) &&
+                    (ujson_strncmp(token->s, key, key_len) == 0)))
+                : ((token->type == UJSON_POINTER_TOKEN_ANY_INDEX) ||
+                   ((token->type == UJSON_POINTER_TOKEN_INDEX) &&
+                    (token->index == index))))
+        {
+            next[next_count++] = alive[i];
+        }
+    }
+    return next_count;
+}
+
+static int ujson_parse_project_in_array(ujson_project_ctx_t* ctx,
+                                        char** p_io, ujson_size_t* len_io,
+                                        ujson_size_t depth,
+                                        ujson_size_t alive_count,
+                                        ujson_t** result_out)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    ujson_t* new_array = NULL;
+    ujson_t* new_element = NULL;
+    ujson_array_item_t* new_element_item;
+    ujson_size_t next_count;
+    ujson_size_t index = 0;
+    /* Skip '[' */
+    p++;
+    len--;
+    ujson_skip_whitespace(&p, &len);
+    if ((len != 0) && (*p == ']'))
+    {
+        goto finish;
+    }
+    for (;;)
+    {
+        next_count =
+            ujson_project_match(ctx, depth, alive_count, NULL, 0, index);
+        if (next_count == 0)
+        {
+            if (ujson_skip_value(&p, &len) != 0)
+            {
+                goto fail;
+            }
+        }
+        else
+        {
+            if (ujson_parse_project_in(ctx, &p, &len, depth + 1, next_count,
+                                       &new_element) != 0)
+            {
+                goto fail;
+            }
+        }
+        if (new_element != NULL)
+        {
+            if ((new_array == NULL) &&
+                ((new_array = ujson_new_array()) == NULL))
+            {
+                goto fail;
+            }
+            if ((new_element_item = ujson_array_item_new(new_element)) ==
+                NULL)
+            {
+                goto fail;
+            }
+            new_element = NULL;
+            ujson_array_push_back(new_array, new_element_item);
+        }
+        index++;
+        ujson_skip_whitespace(&p, &len);
+        if (len == 0)
+        {
+            goto fail;
+        }
+        if (*p == ']')
+        {
             break;
         }
+        if (*p != ',')
+        {
+            goto fail;
+        }
+        p++;
+        len--;
     }
 finish:
-    if (len == 0)
-    {
-        goto fail;
-    }
-    /* Skip '"' */
+    /* Skip ']' */
     p++;
     len--;
-    if ((result = ujson_new_string2(ujson_mbuf_body(&buffer),
-                                    ujson_mbuf_size(&buffer), ch_len)) == NULL)
-    {
-        goto fail;
-    }
     *p_io = p;
     *len_io = len;
+    *result_out = new_array;
+    return 0;
 fail:
-    /* Uninitialize buffer */
-    ujson_mbuf_uninit(&buffer);
-    return result;
+    if (new_array != NULL)
+    {
+        ujson_destroy_value(new_array);
+    }
+    if (new_element != NULL)
+    {
+        ujson_destroy_value(new_element);
+    }
+    return -1;
 }
 
-typedef enum
-{
-    UJSON_PARSE_IN_ARRAY_STATE_INIT = 0,
-    UJSON_PARSE_IN_ARRAY_STATE_VALUE,
-    UJSON_PARSE_IN_ARRAY_STATE_COMMA,
-    UJSON_PARSE_IN_ARRAY_STATE_FINISH,
-} ujson_parse_in_array_state_t;
-
-static ujson_t* ujson_parse_in_array(char** p_io, ujson_size_t* len_io)
+static int ujson_parse_project_in_object(ujson_project_ctx_t* ctx,
+                                         char** p_io, ujson_size_t* len_io,
+                                         ujson_size_t depth,
+                                         ujson_size_t alive_count,
+                                         ujson_t** result_out)
 {
     char* p = *p_io;
     ujson_size_t len = *len_io;
-    ujson_t* new_array = NULL;
-    ujson_t* new_element = NULL;
-    ujson_array_item_t* new_element_item = NULL;
-    ujson_parse_in_array_state_t state = UJSON_PARSE_IN_ARRAY_STATE_INIT;
-    if ((new_array = ujson_new_array()) == NULL)
-    {
-        return NULL;
-    }
-    /* Skip '[' */
+    ujson_t* new_object = NULL;
+    ujson_t* new_key = NULL;
+    ujson_t* new_value = NULL;
+    ujson_object_item_t* new_element_item;
+    char* key_p;
+    ujson_size_t key_len;
+    ujson_bool escaped;
+    ujson_size_t next_count;
+    /* Skip '{' */
     p++;
     len--;
-    while ((len != 0) && (state != UJSON_PARSE_IN_ARRAY_STATE_FINISH))
+    ujson_skip_whitespace(&p, &len);
+    if ((len != 0) && (*p == '}'))
     {
-        switch (state)
+        goto finish;
+    }
+    for (;;)
+    {
+        /* Keys are only decoded when they contain escapes or match */
+        key_p = p;
+        key_len = len;
+        if ((len == 0) || (*p != '"') ||
+            (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0))
         {
-        case UJSON_PARSE_IN_ARRAY_STATE_INIT:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
+            goto fail;
+        }
+        if (escaped == ujson_true)
+        {
+            if ((new_key = ujson_parse_in_string(&key_p, &key_len)) == NULL)
             {
                 goto fail;
             }
-            if (*p == ']')
-            {
-                state = UJSON_PARSE_IN_ARRAY_STATE_FINISH;
-            }
-            else
-            {
-                if ((new_element = ujson_parse_in(&p, &len)) == NULL)
-                {
-                    goto fail;
-                }
-                if ((new_element_item = ujson_array_item_new(new_element)) ==
-                    NULL)
-                {
-                    goto fail;
-                }
-                new_element = NULL;
-                ujson_array_push_back(new_array, new_element_item);
-                new_element_item = NULL;
-                state = UJSON_PARSE_IN_ARRAY_STATE_VALUE;
-            }
-            break;
-        case UJSON_PARSE_IN_ARRAY_STATE_VALUE:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
+            next_count = ujson_project_match(ctx, depth, alive_count,
+                                             new_key->u.part_string.s,
+                                             new_key->u.part_string.len, 0);
+        }
+        else
+        {
+            next_count = ujson_project_match(ctx, depth, alive_count,
+                                             key_p + 1, key_len - len - 2, 0);
+        }
+        ujson_skip_whitespace(&p, &len);
+        if ((len == 0) || (*p != ':'))
+        {
+            goto fail;
+        }
+        p++;
+        len--;
+        if (next_count == 0)
+        {
+            if (ujson_skip_value(&p, &len) != 0)
             {
                 goto fail;
             }
-            if (*p == ']')
-            {
-                state = UJSON_PARSE_IN_ARRAY_STATE_FINISH;
-            }
-            else if (*p == ',')
-            {
-                p++;
-                len--;
-                state = UJSON_PARSE_IN_ARRAY_STATE_COMMA;
-            }
-            else
+        }
+        else
+        {
+            if (ujson_parse_project_in(ctx, &p, &len, depth + 1, next_count,
+                                       &new_value) != 0)
             {
                 goto fail;
             }
-            break;
-        case UJSON_PARSE_IN_ARRAY_STATE_COMMA:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
+        }
+        if (new_value != NULL)
+        {
+            if ((new_object == NULL) &&
+                ((new_object = ujson_new_object()) == NULL))
             {
                 goto fail;
             }
-            if ((new_element = ujson_parse_in(&p, &len)) == NULL)
+            if ((new_key == NULL) &&
+                ((new_key = ujson_parse_in_string(&key_p, &key_len)) == NULL))
             {
                 goto fail;
             }
-            if ((new_element_item = ujson_array_item_new(new_element)) == NULL)
+            if ((new_element_item =
+                     ujson_object_item_new(new_key, new_value)) == NULL)
             {
                 goto fail;
             }
-            new_element = NULL;
-            ujson_array_push_back(new_array, new_element_item);
-            new_element_item = NULL;
-            state = UJSON_PARSE_IN_ARRAY_STATE_VALUE;
-            break;
-        case UJSON_PARSE_IN_ARRAY_STATE_FINISH:
+            new_key = NULL;
+            new_value = NULL;
+            ujson_object_push_back(new_object, new_element_item);
+        }
+        if (new_key != NULL)
+        {
+            ujson_destroy_value(new_key);
+            new_key = NULL;
+        }
+        ujson_skip_whitespace(&p, &len);
+        if (len == 0)
+        {
+            goto fail;
+        }
+        if (*p == '}')
+        {
             break;
         }
+        if (*p != ',')
+        {
+            goto fail;
+        }
+        p++;
+        len--;
+        ujson_skip_whitespace(&p, &len);
+    }
+finish:
+    /* Skip '}' */
+    p++;
+    len--;
+    *p_io = p;
+    *len_io = len;
+    *result_out = new_object;
+    return 0;
+fail:
+    if (new_object != NULL)
+    {
+        ujson_destroy_value(new_object);
+    }
+    if (new_key != NULL)
+    {
+        ujson_destroy_value(new_key);
+    }
+    if (new_value != NULL)
+    {
+        ujson_destroy_value(new_value);
+    }
+    return -1;
+}
+
+/* Produce the projected value, or NULL in *result_out if nothing matched */
+static int ujson_parse_project_in(ujson_project_ctx_t* ctx, char** p_io,
+                                  ujson_size_t* len_io, ujson_size_t depth,
+                                  ujson_size_t alive_count,
+                                  ujson_t** result_out)
+{
+    ujson_size_t* alive = ctx->alive + depth * ctx->project->size;
+    ujson_size_t i;
+
+    *result_out = NULL;
+    ujson_skip_whitespace(p_io, len_io);
+    if (*len_io == 0)
+    {
+        return -1;
+    }
+    /* A path ending here selects the whole subtree */
+    for (i = 0; i != alive_count; i++)
+    {
+        if (ctx->project->paths[alive[i]]->size == depth)
+        {
+            *result_out = ujson_parse_in(&ctx->parse, p_io, len_io);
+            return (*result_out == NULL) ? -1 : 0;
+        }
+    }
+    if (**p_io == '[')
+    {
+        return ujson_parse_project_in_array(ctx, p_io, len_io, depth,
+                                            alive_count, result_out);
+    }
+    else if (**p_io == '{')
+    {
+        return ujson_parse_project_in_object(ctx, p_io, len_io, depth,
+                                             alive_count, result_out);
+    }
+    return ujson_skip_value(p_io, len_io);
+}
+
+/* Parse only the selected paths of a JSON string */
+ujson_t* ujson_parse_project(char* s, ujson_size_t len,
+                             const ujson_project_t* project)
+{
+    ujson_project_ctx_t ctx;
+    ujson_parse_config_t config;
+    ujson_t* result = NULL;
+    ujson_size_t i;
+
+    ujson_skip_whitespace(&s, &len);
+    if ((len == 0) || ((*s != '[') && (*s != '{')))
+    {
+        return NULL;
+    }
+    ujson_parse_config_init(&config);
+    ujson_parse_ctx_init(&ctx.parse, &config);
+    ctx.project = project;
+    if ((ctx.alive = (ujson_size_t*)ujson_malloc(
+             sizeof(ujson_size_t) * project->size * (project->depth + 1))) ==
+        NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i != project->size; i++)
+    {
+        ctx.alive[i] = i;
+    }
+    if (ujson_parse_project_in(&ctx, &s, &len, 0, project->size, &result) !=
+        0)
+    {
+        goto fail;
+    }
+    /* The root container is kept even when nothing inside matched */
+    if ((result == NULL) &&
+        ((result = (*(s - 1) == ']') ? ujson_new_array()
+                                     : ujson_new_object()) == NULL))
+    {
+        goto fail;
+    }
+fail:
+    ujson_free(ctx.alive);
+    return result;
+}
+
+/* Binding */
+
+struct ujson_bind_entry
+{
+    const char* name;
+    ujson_size_t name_len;
+    unsigned int hash;
+    ujson_size_t offset;
+    ujson_bind_type_t type;
+    const ujson_bind_desc_t* nested;
+    /* ',"name":' escaped once for stringify */
+    char* key_text;
+    ujson_size_t key_text_len;
+};
+typedef struct ujson_bind_entry ujson_bind_entry_t;
+
+struct ujson_bind_desc
+{
+    ujson_bind_entry_t* entries;
+    ujson_size_t size;
+    /* Open addressing table of (entry index + 1), 0 for an empty slot,
+     * followed by the key texts of the entries */
+    ujson_size_t* slots;
+    ujson_size_t mask;
+};
+
+/* Keys are matched by hash alone when no two fields share a slot */
+#define UJSON_BIND_SLOTS_MAX_FACTOR 16
+
+static int ujson_bind_desc_collides(const ujson_bind_desc_t* desc,
+                                    ujson_size_t mask)
+{
+    ujson_size_t i, j;
+    for (i = 0; i != desc->size; i++)
+    {
+        for (j = i + 1; j != desc->size; j++)
+        {
+            if ((desc->entries[i].hash & mask) ==
+                (desc->entries[j].hash & mask))
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+ujson_bind_desc_t* ujson_bind_desc_new(const ujson_bind_field_t* fields,
+                                       ujson_size_t count)
+{
+    ujson_bind_desc_t* desc;
+    ujson_bind_entry_t* entry;
+    ujson_mbuf_t key_texts;
+    char* key_text;
+    ujson_size_t key_text_start;
+    ujson_size_t slots_count = 1;
+    ujson_size_t i, slot;
+
+    if ((desc = (ujson_bind_desc_t*)ujson_malloc(
+             sizeof(ujson_bind_desc_t) + sizeof(ujson_bind_entry_t) * count)) ==
+        NULL)
+    {
+        return NULL;
+    }
+    desc->entries = (ujson_bind_entry_t*)(desc + 1);
+    desc->size = count;
+    for (i = 0; i != count; i++)
+    {
+        entry = &desc->entries[i];
+        if ((fields[i].type == UJSON_BIND_OBJECT) && (fields[i].nested == NULL))
+        {
+            ujson_free(desc);
+            return NULL;
+        }
+        entry->name = fields[i].name;
+        entry->name_len = ujson_strlen(entry->name);
+        entry->hash = ujson_hash(entry->name, entry->name_len);
+        entry->offset = fields[i].offset;
+        entry->type = fields[i].type;
+        entry->nested = fields[i].nested;
+    }
+
+    /* Grow the table until every field owns its slot, within reason */
+    while (slots_count < count * 2)
+    {
+        slots_count <<= 1;
+    }
+    while ((slots_count < count * 2 * UJSON_BIND_SLOTS_MAX_FACTOR) &&
+           (ujson_bind_desc_collides(desc, slots_count - 1)))
+    {
+        slots_count <<= 1;
+    }
+
+    /* Quote and escape every key up front */
+    if (ujson_mbuf_init(&key_texts) != 0)
+    {
+        ujson_free(desc);
+        return NULL;
+    }
+    for (i = 0; i != count; i++)
+    {
+        entry = &desc->entries[i];
+        key_text_start = ujson_mbuf_size(&key_texts);
+        if ((ujson_mbuf_append(&key_texts, ",\"", 2) != 0) ||
+            (ujson_stringify_string_body(&key_texts, entry->name,
+                                         entry->name_len) != 0) ||
+            (ujson_mbuf_append(&key_texts, "\":", 2) != 0))
+        {
+            ujson_mbuf_uninit(&key_texts);
+            ujson_free(desc);
+            return NULL;
+        }
+        entry->key_text_len = ujson_mbuf_size(&key_texts) - key_text_start;
+    }
+
+    if ((desc->slots = (ujson_size_t*)ujson_malloc(
+             sizeof(ujson_size_t) * slots_count +
+             sizeof(char) * ujson_mbuf_size(&key_texts))) == NULL)
+    {
+        ujson_mbuf_uninit(&key_texts);
+        ujson_free(desc);
+        return NULL;
+    }
+    key_text = (char*)(desc->slots + slots_count);
+    ujson_memcpy(key_text, ujson_mbuf_body(&key_texts),
+                 ujson_mbuf_size(&key_texts));
+    ujson_mbuf_uninit(&key_texts);
+    for (i = 0; i != count; i++)
+    {
+        desc->entries[i].key_text = key_text;
+        key_text += desc->entries[i].key_text_len;
+    }
+
+    desc->mask = slots_count - 1;
+    for (i = 0; i != slots_count; i++)
+    {
+        desc->slots[i] = 0;
+    }
+    for (i = 0; i != count; i++)
+    {
+        slot = desc->entries[i].hash & desc->mask;
+        while (desc->slots[slot] != 0)
+        {
+            slot = (slot + 1) & desc->mask;
+        }
+        desc->slots[slot] = i + 1;
+    }
+
+    return desc;
+}
+
+void ujson_bind_desc_destroy(ujson_bind_desc_t* desc)
+{
+    ujson_free(desc->slots);
+    ujson_free(desc);
+}
+
+static const ujson_bind_entry_t*
+ujson_bind_desc_lookup(const ujson_bind_desc_t* desc, const char* name,
+                       ujson_size_t len)
+{
+    const ujson_bind_entry_t* entry;
+    unsigned int hash = ujson_hash(name, len);
+    ujson_size_t slot = hash & desc->mask;
+    while (desc->slots[slot] != 0)
+    {
+        entry = &desc->entries[desc->slots[slot] - 1];
+        if ((entry->hash == hash) && (entry->name_len == len) &&
+            (ujson_strncmp(entry->name, name, len) == 0))
+        {
+            return entry;
+        }
+        slot = (slot + 1) & desc->mask;
     }
-    /* Skip ']' */
-    p++;
-    len--;
-    *p_io = p;
-    *len_io = len;
-    goto done;
-fail:
-    if (new_array != NULL)
+    return NULL;
+}
+
+typedef struct
+{
+    /* Scratch space for escaped keys and strings, set up on first use */
+    ujson_mbuf_t scratch;
+} ujson_bind_ctx_t;
+
+/* Decode the string at *p_io into the scratch buffer */
+static int ujson_bind_decode_string(ujson_bind_ctx_t* ctx, char** p_io,
+                                    ujson_size_t* len_io)
+{
+    ujson_size_t ch_len;
+    if ((ctx->scratch.body == NULL) && (ujson_mbuf_init(&ctx->scratch) != 0))
     {
-        ujson_destroy_value(new_array);
-        new_array = NULL;
+        return -1;
     }
-    if (new_element != NULL)
+    ctx->scratch.size = 0;
+    /* Skip '"' */
+    (*p_io)++;
+    (*len_io)--;
+    if ((ujson_string_decode(p_io, len_io, &ctx->scratch, &ch_len, NULL) !=
+         0) ||
+        (*len_io == 0))
     {
-        ujson_destroy_value(new_element);
+        return -1;
     }
-done:
-    return new_array;
+    /* Skip '"' */
+    (*p_io)++;
+    (*len_io)--;
+    return 0;
 }
 
-typedef enum
-{
-    UJSON_PARSE_IN_OBJECT_STATE_INIT = 0,
-    UJSON_PARSE_IN_OBJECT_STATE_KEY,
-    UJSON_PARSE_IN_OBJECT_STATE_COLON,
-    UJSON_PARSE_IN_OBJECT_STATE_VALUE,
-    UJSON_PARSE_IN_OBJECT_STATE_COMMA,
-    UJSON_PARSE_IN_OBJECT_STATE_FINISH,
-} ujson_parse_in_object_state_t;
+static int ujson_bind_parse_object(ujson_bind_ctx_t* ctx,
+                                   const ujson_bind_desc_t* desc, char* base,
+                                   char** p_io, ujson_size_t* len_io);
 
-static ujson_t* ujson_parse_in_object(char** p_io, ujson_size_t* len_io)
+static int ujson_bind_parse_field(ujson_bind_ctx_t* ctx,
+                                  const ujson_bind_entry_t* entry, char* base,
+                                  char** p_io, ujson_size_t* len_io)
 {
     char* p = *p_io;
     ujson_size_t len = *len_io;
-    ujson_t* new_array = NULL;
-    ujson_t* new_key = NULL;
-    ujson_t* new_value = NULL;
-    ujson_object_item_t* new_element_item = NULL;
-    ujson_parse_in_object_state_t state = UJSON_PARSE_IN_OBJECT_STATE_INIT;
-    if ((new_array = ujson_new_object()) == NULL)
+    char* field = base + entry->offset;
+    char* start;
+    ujson_size_t start_len;
+    char* body;
+    ujson_size_t body_len;
+    ujson_bool escaped;
+    int value;
+    double value_double;
+    ujson_bool is_double;
+
+    /* null leaves the field as it is */
+    if (ujson_match_literal(p, len, UJSON_CHAR_NULL) != 0)
     {
-        return NULL;
+        *p_io = p + 4;
+        *len_io = len - 4;
+        return 0;
+    }
+    switch (entry->type)
+    {
+    case UJSON_BIND_INT:
+    case UJSON_BIND_DOUBLE:
+        if ((UJSON_CHAR_CLASS(*p) != UJSON_CHAR_NUMBER) ||
+            (ujson_lex_number(&p, &len, &value, &value_double, &is_double,
+                              ujson_false) != 0))
+        {
+            return -1;
+        }
+        if (entry->type == UJSON_BIND_INT)
+        {
+            *(int*)field = value;
+        }
+        else
+        {
+            *(double*)field = value_double;
+        }
+        break;
+    case UJSON_BIND_BOOL:
+        if (ujson_match_literal(p, len, UJSON_CHAR_TRUE) != 0)
+        {
+            *(ujson_bool*)field = ujson_true;
+            p += 4;
+            len -= 4;
+        }
+        else if (ujson_match_literal(p, len, UJSON_CHAR_FALSE) != 0)
+        {
+            *(ujson_bool*)field = ujson_false;
+            p += 5;
+            len -= 5;
+        }
+        else
+        {
+            return -1;
+        }
+        break;
+    case UJSON_BIND_STRING:
+        if (*p != '"')
+        {
+            return -1;
+        }
+        start = p;
+        start_len = len;
+        if (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0)
+        {
+            return -1;
+        }
+        body = start + 1;
+        body_len = (ujson_size_t)(p - start) - 2;
+        if (escaped == ujson_true)
+        {
+            if (ujson_bind_decode_string(ctx, &start, &start_len) != 0)
+            {
+                return -1;
+            }
+            body = ujson_mbuf_body(&ctx->scratch);
+            body_len = ujson_mbuf_size(&ctx->scratch);
+        }
+        /* Left by an earlier parse or a repeated key */
+        if (*(char**)field != NULL)
+        {
+            ujson_free(*(char**)field);
+        }
+        if ((*(char**)field = (char*)ujson_malloc(sizeof(char) *
+                                                  (body_len + 1))) == NULL)
+        {
+            return -1;
+        }
+        ujson_memcpy(*(char**)field, body, body_len);
+        (*(char**)field)[body_len] = '\0';
+        break;
+    case UJSON_BIND_OBJECT:
+        if ((*p != '{') ||
+            (ujson_bind_parse_object(ctx, entry->nested, field, &p, &len) !=
+             0))
+        {
+            return -1;
+        }
+        break;
     }
+    *p_io = p;
+    *len_io = len;
+    return 0;
+}
+
+static int ujson_bind_parse_object(ujson_bind_ctx_t* ctx,
+                                   const ujson_bind_desc_t* desc, char* base,
+                                   char** p_io, ujson_size_t* len_io)
+{
+    char* p = *p_io;
+    ujson_size_t len = *len_io;
+    const ujson_bind_entry_t* entry;
+    char* key_p;
+    ujson_size_t key_len;
+    ujson_bool escaped;
     /* Skip '{' */
     p++;
     len--;
-    while ((len != 0) && (state != UJSON_PARSE_IN_OBJECT_STATE_FINISH))
+    ujson_skip_whitespace(&p, &len);
+    if ((len != 0) && (*p == '}'))
     {
-        switch (state)
+        goto finish;
+    }
+    for (;;)
+    {
+        key_p = p;
+        key_len = len;
+        if ((len == 0) || (*p != '"') ||
+            (ujson_skip_string(&p, &len, &escaped, ujson_false) != 0))
         {
-        case UJSON_PARSE_IN_OBJECT_STATE_INIT:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
-            {
-                goto fail;
-            }
-            if (*p == '}')
-            {
-                state = UJSON_PARSE_IN_OBJECT_STATE_FINISH;
-            }
-            else
-            {
-                if ((new_key = ujson_parse_in(&p, &len)) == NULL)
-                {
-                    goto fail;
-                }
-                if (new_key->type != UJSON_STRING)
-                {
-                    goto fail;
-                }
-                state = UJSON_PARSE_IN_OBJECT_STATE_KEY;
-            }
-            break;
-        case UJSON_PARSE_IN_OBJECT_STATE_KEY:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
-            {
-                goto fail;
-            }
-            if (*p != ':')
-            {
-                goto fail;
-            }
-            p++;
-            len--;
-            state = UJSON_PARSE_IN_OBJECT_STATE_COLON;
-            break;
-        case UJSON_PARSE_IN_OBJECT_STATE_COLON:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
-            {
-                goto fail;
-            }
-            if ((new_value = ujson_parse_in(&p, &len)) == NULL)
-            {
-                goto fail;
-            }
-            if ((new_element_item =
-                     ujson_object_item_new(new_key, new_value)) == NULL)
-            {
-                goto fail;
-            }
-            new_key = NULL;
-            new_value = NULL;
-            ujson_object_push_back(new_array, new_element_item);
-            new_element_item = NULL;
-            state = UJSON_PARSE_IN_OBJECT_STATE_VALUE;
-            break;
-        case UJSON_PARSE_IN_OBJECT_STATE_VALUE:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
-            {
-                goto fail;
-            }
-            if (*p == '}')
-            {
-                state = UJSON_PARSE_IN_OBJECT_STATE_FINISH;
-            }
-            else if (*p == ',')
-            {
-                state = UJSON_PARSE_IN_OBJECT_STATE_COMMA;
-                p++;
-                len--;
-            }
-            else
+            return -1;
+        }
+        if (escaped == ujson_true)
+        {
+            if (ujson_bind_decode_string(ctx, &key_p, &key_len) != 0)
             {
-                goto fail;
+                return -1;
             }
-            break;
-        case UJSON_PARSE_IN_OBJECT_STATE_COMMA:
-            ujson_skip_whitespace(&p, &len);
-            if (len == 0)
+            entry = ujson_bind_desc_lookup(desc, ujson_mbuf_body(&ctx->scratch),
+                                           ujson_mbuf_size(&ctx->scratch));
+        }
+        else
+        {
+            entry = ujson_bind_desc_lookup(desc, key_p + 1, key_len - len - 2);
+        }
+        ujson_skip_whitespace(&p, &len);
+        if ((len == 0) || (*p != ':'))
+        {
+            return -1;
+        }
+        p++;
+        len--;
+        ujson_skip_whitespace(&p, &len);
+        if (len == 0)
+        {
+            return -1;
+        }
+        /* Unknown keys are skipped */
+        if (entry == NULL)
+        {
+            if (ujson_skip_value(&p, &len) != 0)
             {
-                goto fail;
+                return -1;
             }
-            if ((new_key = ujson_parse_in(&p, &len)) == NULL)
+        }
+        else
+        {
+            if (ujson_bind_parse_field(ctx, entry, base, &p, &len) != 0)
             {
-                goto fail;
+                return -1;
             }
-            state = UJSON_PARSE_IN_OBJECT_STATE_KEY;
-            break;
-        case UJSON_PARSE_IN_OBJECT_STATE_FINISH:
+        }
+        ujson_skip_whitespace(&p, &len);
+        if (len == 0)
+        {
+            return -1;
+        }
+        if (*p == '}')
+        {
             break;
         }
+        if (*p != ',')
+        {
+            return -1;
+        }
+        p++;
+        len--;
+        ujson_skip_whitespace(&p, &len);
     }
+finish:
     /* Skip '}' */
     p++;
     len--;
     *p_io = p;
     *len_io = len;
-    goto done;
-fail:
-    if (new_array != NULL)
+    return 0;
+}
+
+/* Decode a JSON object straight into a C struct */
+int ujson_bind_parse(const ujson_bind_desc_t* desc, void* struct_ptr, char* s,
+                     ujson_size_t len)
+{
+    ujson_bind_ctx_t ctx;
+    int ret = -1;
+
+    ctx.scratch.body = NULL;
+    ujson_skip_whitespace(&s, &len);
+    if ((len != 0) && (*s == '{'))
     {
-        ujson_destroy_value(new_array);
-        new_array = NULL;
+        ret = ujson_bind_parse_object(&ctx, desc, (char*)struct_ptr, &s, &len);
     }
-    if (new_key != NULL)
+    ujson_mbuf_uninit(&ctx.scratch);
+    return ret;
+}
+
+/* Release the strings held by a bound struct */
+void ujson_bind_free(const ujson_bind_desc_t* desc, void* struct_ptr)
+{
+    const ujson_bind_entry_t* entry;
+    char* field;
+    ujson_size_t i;
+
+    for (i = 0; i != desc->size; i++)
     {
-        ujson_destroy_value(new_key);
+        entry = &desc->entries[i];
+        field = (char*)struct_ptr + entry->offset;
+        if (entry->type == UJSON_BIND_STRING)
+        {
+            if (*(char**)field != NULL)
+            {
+                ujson_free(*(char**)field);
+                *(char**)field = NULL;
+            }
+        }
+        else if (entry->type == UJSON_BIND_OBJECT)
+        {
+            ujson_bind_free(entry->nested, field);
+        }
+    }
+}
+
+static int ujson_stringify_number(ujson_mbuf_t* mbuf, int as_int,
+                                  double as_double, ujson_bool is_double)
+{
+    char buf[32];
+    int len;
+    if (is_double == ujson_true)
+    {
+        len = snprintf(buf, 32, "%.12lf", as_double);
+    }
+    else
+    {
+        len = snprintf(buf, 32, "%d", as_int);
+    }
+    if (len < 0)
+    {
+        return -1;
     }
-    if (new_value != NULL)
+    if (ujson_mbuf_append(mbuf, buf, (ujson_size_t)len) != 0)
     {
-        ujson_destroy_value(new_value);
+        return -1;
     }
-done:
-    return new_array;
+    return 0;
 }
 
-#define MATCH_IDENTIFIER(p, len, expected_s, expected_len)                     \
-    (((len == expected_len) ||                                                 \
-      ((len > expected_len) && (!ISID(*(p + expected_len))))) &&               \
-     (ujson_strncmp(p, expected_s, expected_len) == 0))
-
-static ujson_t* ujson_parse_in(char** p_io, ujson_size_t* len_io)
+/* Shortest digits that read back as the same double, laid out like
+ * ECMAScript Number.prototype.toString (RFC 8785) */
+static int ujson_stringify_number_canonical(ujson_mbuf_t* mbuf, double value)
 {
-    char* p = *p_io;
-    ujson_size_t len = *len_io;
-    ujson_t* result = NULL;
-    /* Skip whitespace */
-    ujson_skip_whitespace(&p, &len);
-    if (ISDIGIT(*p))
+    char buf[32];
+    char digits[20];
+    char out[40];
+    double check;
+    int precision;
+    int digits_len = 0;
+    int exponent = 0;
+    int point;
+    int out_len = 0;
+    int i;
+    char* p;
+    ujson_bool exponent_negative;
+    /* NaN and infinities have no JSON form */
+    if ((value != value) || (value - value != 0))
+    {
+        return -1;
+    }
+    if (value == 0)
+    {
+        return ujson_mbuf_append(mbuf, "0", 1);
+    }
+    for (precision = 1; precision <= 17; precision++)
     {
-        result = ujson_parse_in_number(&p, &len);
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, value);
+        if ((sscanf(buf, "%lf", &check) == 1) && (check == value))
+        {
+            break;
+        }
     }
-    else if (*p == '-')
+    /* buf is [-]d[.ddd]e[+-]dd */
+    p = buf;
+    if (*p == '-')
     {
-        result = ujson_parse_in_number(&p, &len);
+        out[out_len++] = '-';
+        p++;
     }
-    else if (*p == '\"')
+    for (; *p != 'e'; p++)
     {
-        result = ujson_parse_in_string(&p, &len);
+        if (*p != '.')
+        {
+            digits[digits_len++] = *p;
+        }
     }
-    else if (MATCH_IDENTIFIER(p, len, "null", 4))
+    p++;
+    exponent_negative = (*p == '-') ? ujson_true : ujson_false;
+    for (p++; *p != '\0'; p++)
     {
-        result = ujson_new(UJSON_NULL);
-        p += 4;
-        len -= 4;
+        exponent = exponent * 10 + (*p - '0');
     }
-    else if (MATCH_IDENTIFIER(p, len, "undefined", 9))
+    if (exponent_negative == ujson_true)
     {
-        result = ujson_new(UJSON_UNDEFINED);
-        p += 9;
-        len -= 9;
+        exponent = -exponent;
     }
-    else if (MATCH_IDENTIFIER(p, len, "true", 4))
+    while ((digits_len > 1) && (digits[digits_len - 1] == '0'))
     {
-        result = ujson_new_bool(ujson_true);
-        p += 4;
-        len -= 4;
+        digits_len--;
     }
-    else if (MATCH_IDENTIFIER(p, len, "false", 5))
+    /* Digits are d.ddd * 10^exponent, so the point goes after point digits */
+    point = exponent + 1;
+    if ((digits_len <= point) && (point <= 21))
     {
-        result = ujson_new_bool(ujson_false);
-        p += 5;
-        len -= 5;
+        for (i = 0; i != point; i++)
+        {
+            out[out_len++] = (i < digits_len) ? digits[i] : '0';
+        }
     }
-    else if (*p == '[')
+    else if ((0 < point) && (point <= 21))
     {
-        result = ujson_parse_in_array(&p, &len);
+        for (i = 0; i != digits_len; i++)
+        {
+            if (i == point)
+            {
+                out[out_len++] = '.';
+            }
+            out[out_len++] = digits[i];
+        }
     }
-    else if (*p == '{')
+    else if ((-6 < point) && (point <= 0))
     {
-        result = ujson_parse_in_object(&p, &len);
+        out[out_len++] = '0';
+        out[out_len++] = '.';
+        for (i = point; i != 0; i++)
+        {
+            out[out_len++] = '0';
+        }
+        for (i = 0; i != digits_len; i++)
+        {
+            out[out_len++] = digits[i];
+        }
     }
     else
     {
-        result = NULL;
+        out[out_len++] = digits[0];
+        if (digits_len > 1)
+        {
+            out[out_len++] = '.';
+            for (i = 1; i != digits_len; i++)
+            {
+                out[out_len++] = digits[i];
+            }
+        }
+        out_len += sprintf(out + out_len, "e%c%d", (point > 0) ? '+' : '-',
+                           (point > 0) ? point - 1 : 1 - point);
     }
-    *p_io = p;
-    *len_io = len;
-    return result;
+    return ujson_mbuf_append(mbuf, out, (ujson_size_t)out_len);
 }
 
-/* Parse a JSON string and generate a JSON value */
-ujson_t* ujson_parse(char* s, ujson_size_t len)
+static int ujson_stringify_value_number(ujson_stringify_ctx_t* ctx,
+                                        const ujson_t* ujson)
 {
-    return ujson_parse_in(&s, &len);
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    char* p;
+    ujson_size_t len;
+    int value;
+    double value_double;
+    ujson_bool is_double;
+    if (ctx->config->canonical == ujson_true)
+    {
+        value_double = ujson->u.part_number.as_double;
+        if (ujson->u.part_number.raw != NULL)
+        {
+            p = ujson->u.part_number.raw;
+            len = ujson->u.part_number.raw_len;
+            ujson_lex_number(&p, &len, &value, &value_double, &is_double,
+                             ujson_false);
+        }
+        return ujson_stringify_number_canonical(mbuf, value_double);
+    }
+    /* Lazily parsed numbers are written back exactly as they came in */
+    if (ujson->u.part_number.raw != NULL)
+    {
+        return ujson_mbuf_append(mbuf, ujson->u.part_number.raw,
+                                 ujson->u.part_number.raw_len);
+    }
+    return ujson_stringify_number(mbuf, ujson->u.part_number.as_int,
+                                  ujson->u.part_number.as_double,
+                                  ujson->u.part_number.is_double);
 }
 
-static int ujson_stringify_value_number(ujson_mbuf_t* mbuf,
-                                        const ujson_t* ujson)
+/* \uXXXX for the UTF-8 sequence at p, a surrogate pair past U+FFFF */
+static int ujson_escape_utf8(char* writebuf, const char* p,
+                             ujson_size_t bytes_number)
 {
-    char buf[32];
-    int len;
-    if (ujson->u.part_number.is_double == ujson_true)
+    const unsigned char* s = (const unsigned char*)p;
+    unsigned long code_point;
+    ujson_size_t i;
+    code_point = s[0] & (0x7f >> bytes_number);
+    for (i = 1; i != bytes_number; i++)
     {
-        len = snprintf(buf, 32, "%.12lf", ujson->u.part_number.as_double);
+        code_point = (code_point << 6) | (s[i] & 0x3f);
     }
-    else
+    if (code_point > 0x10ffff)
     {
-        len = snprintf(buf, 32, "%d", ujson->u.part_number.as_int);
+        return -1;
     }
-    if (len < 0)
+    if (code_point > 0xffff)
     {
-        return -1;
+        code_point -= 0x10000;
+        sprintf(writebuf, "\\u%04lx\\u%04lx", 0xd800 + (code_point >> 10),
+                0xdc00 + (code_point & 0x3ff));
     }
-    if (ujson_mbuf_append(mbuf, buf, (ujson_size_t)len) != 0)
+    else
     {
-        return -1;
+        sprintf(writebuf, "\\u%04lx", code_point);
     }
     return 0;
 }
 
-static int ujson_stringify_value_string(ujson_mbuf_t* mbuf,
-                                        const ujson_t* ujson)
+/* Escape a string body, without the surrounding quotes; with ascii_only
+ * every non-ASCII code point is escaped as well, and '/' only with
+ * escape_solidus */
+static int ujson_stringify_string_body_ex(ujson_mbuf_t* mbuf, const char* p,
+                                          ujson_size_t len,
+                                          ujson_bool ascii_only,
+                                          ujson_bool escape_solidus)
 {
-    char* p = ujson->u.part_string.s;
-    ujson_size_t len = ujson->u.part_string.len;
+    const char* run = p;
     ujson_size_t bytes_number;
-    if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
+    ujson_size_t escaped_len;
+    const char* escape;
+    char writebuf[13];
+    /* Clean runs are copied in one piece into the room reserved here */
+    if (ujson_mbuf_reserve(mbuf, len) != 0)
     {
         return -1;
     }
     while (len != 0)
     {
+        /* Skip clean ASCII a word at a time */
+        while ((len >= sizeof(unsigned long)) &&
+               (UJSON_SWAR_ESCAPE_STOP(ujson_load_long(p)) == 0))
+        {
+            p += sizeof(unsigned long);
+            len -= sizeof(unsigned long);
+        }
+        if (len == 0)
+        {
+            break;
+        }
+        escaped_len = 1;
         switch (*p)
         {
         case '\"':
-            if (ujson_mbuf_append(mbuf, "\\\"", 2) != 0)
-            {
-                return -1;
-            }
-            p++;
-            len--;
+            escape = "\\\"";
             break;
         case '\\':
-            if (ujson_mbuf_append(mbuf, "\\\\", 2) != 0)
-            {
-                return -1;
-            }
-            p++;
-            len--;
+            escape = "\\\\";
             break;
         case '/':
-            if (ujson_mbuf_append(mbuf, "\\/", 2) != 0)
+            if (escape_solidus == ujson_false)
             {
-                return -1;
+                p++;
+                len--;
+                continue;
             }
-            p++;
-            len--;
+            escape = "\\/";
             break;
         case '\b':
-            if (ujson_mbuf_append(mbuf, "\\b", 2) != 0)
-            {
-                return -1;
-            }
-            p++;
-            len--;
+            escape = "\\b";
             break;
         case '\f':
-            if (ujson_mbuf_append(mbuf, "\\f", 2) != 0)
-            {
-                return -1;
-            }
-            p++;
-            len--;
+            escape = "\\f";
             break;
         case '\n':
-            if (ujson_mbuf_append(mbuf, "\\n", 2) != 0)
-            {
-                return -1;
-            }
-            p++;
-            len--;
+            escape = "\\n";
             break;
         case '\r':
-            if (ujson_mbuf_append(mbuf, "\\r", 2) != 0)
+            escape = "\\r";
+            break;
+        case '\t':
+            escape = "\\t";
+            break;
+        default:
+            if ((unsigned char)*p < 0x20)
             {
-                return -1;
+                sprintf(writebuf, "\\u%04x", (unsigned int)*p);
+                escape = writebuf;
+            }
+            else
+            {
+                bytes_number = IS_HYPER_ID(*p) ? id_hyper_length(*p) : 1;
+                if ((bytes_number == 0) || (len < bytes_number))
+                {
+                    return -1;
+                }
+                if ((bytes_number == 1) || (ascii_only == ujson_false))
+                {
+                    /* Part of the clean run */
+                    p += bytes_number;
+                    len -= bytes_number;
+                    continue;
+                }
+                if (ujson_escape_utf8(writebuf, p, bytes_number) != 0)
+                {
+                    return -1;
+                }
+                escape = writebuf;
+                escaped_len = bytes_number;
             }
+            break;
+        }
+        if ((ujson_mbuf_append(mbuf, run, (ujson_size_t)(p - run)) != 0) ||
+            (ujson_mbuf_append(mbuf, escape, ujson_strlen(escape)) != 0))
+        {
+            return -1;
+        }
+        p += escaped_len;
+        len -= escaped_len;
+        run = p;
+    }
+    return ujson_mbuf_append(mbuf, run, (ujson_size_t)(p - run));
+}
+
+static int ujson_stringify_string_body(ujson_mbuf_t* mbuf, const char* p,
+                                       ujson_size_t len)
+{
+    return ujson_stringify_string_body_ex(mbuf, p, len, ujson_false,
+                                          ujson_true);
+}
+
+/* Copy a body that needs no other escaping, escaping only non-ASCII code
+ * points */
+static int ujson_stringify_string_ascii(ujson_mbuf_t* mbuf, const char* p,
+                                        ujson_size_t len)
+{
+    const char* run = p;
+    ujson_size_t bytes_number;
+    char writebuf[13];
+    if (ujson_mbuf_reserve(mbuf, len) != 0)
+    {
+        return -1;
+    }
+    while (len != 0)
+    {
+        /* Skip ASCII a word at a time */
+        while ((len >= sizeof(unsigned long)) &&
+               ((ujson_load_long(p) & (UJSON_SWAR_ONES * 128)) == 0))
+        {
+            p += sizeof(unsigned long);
+            len -= sizeof(unsigned long);
+        }
+        if (len == 0)
+        {
+            break;
+        }
+        if (!IS_HYPER_ID(*p))
+        {
             p++;
             len--;
-            break;
-        case '\t':
-            if (ujson_mbuf_append(mbuf, "\\t", 2) != 0)
+            continue;
+        }
+        bytes_number = id_hyper_length(*p);
+        if ((bytes_number == 0) || (len < bytes_number) ||
+            (ujson_escape_utf8(writebuf, p, bytes_number) != 0) ||
+            (ujson_mbuf_append(mbuf, run, (ujson_size_t)(p - run)) != 0) ||
+            (ujson_mbuf_append(mbuf, writebuf, ujson_strlen(writebuf)) != 0))
+        {
+            return -1;
+        }
+        p += bytes_number;
+        len -= bytes_number;
+        run = p;
+    }
+    return ujson_mbuf_append(mbuf, run, (ujson_size_t)(p - run));
+}
+
+static int ujson_stringify_value_string(ujson_stringify_ctx_t* ctx,
+                                        const ujson_t* ujson)
+{
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    ujson_bool ascii_only = ctx->config->ascii_only;
+    const char* p;
+    char* raw;
+    ujson_size_t len;
+    ujson_size_t ch_len;
+    int ret;
+    if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
+    {
+        return -1;
+    }
+    /* Canonical output escapes lazily parsed strings afresh */
+    if ((ujson->u.part_string.lazy != 0) &&
+        (ctx->config->canonical == ujson_true))
+    {
+        raw = ujson->u.part_string.s;
+        len = ujson->u.part_string.len;
+        if ((ctx->scratch.body == NULL) && (ujson_mbuf_init(&ctx->scratch) != 0))
+        {
+            return -1;
+        }
+        ctx->scratch.size = 0;
+        if (ujson_string_decode(&raw, &len, &ctx->scratch, &ch_len, NULL) != 0)
+        {
+            return -1;
+        }
+        ret = ujson_stringify_string_body_ex(
+            mbuf, ujson_mbuf_body(&ctx->scratch),
+            ujson_mbuf_size(&ctx->scratch), ascii_only, ujson_false);
+    }
+    /* Lazily parsed strings are still escaped as they came in, and parsed
+     * strings known to need no escaping are copied as they are */
+    else if ((ujson->u.part_string.lazy != 0) ||
+             (ujson->u.part_string.plain == ujson_true))
+    {
+        p = ujson->u.part_string.s;
+        len = ujson->u.part_string.len;
+        ret = (ascii_only == ujson_true)
+                  ? ujson_stringify_string_ascii(mbuf, p, len)
+                  : ujson_mbuf_append(mbuf, p, len);
+    }
+    else
+    {
+        ret = ujson_stringify_string_body_ex(
+            mbuf, ujson->u.part_string.s, ujson->u.part_string.len, ascii_only,
+            (ctx->config->canonical == ujson_true) ? ujson_false : ujson_true);
+    }
+    if ((ret != 0) || (ujson_mbuf_append(mbuf, "\"", 1) != 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* A line break and the indentation of the current level, copied in one
+ * piece from the indent buffer */
+static int ujson_stringify_newline(ujson_stringify_ctx_t* ctx)
+{
+    ujson_size_t width = 1;
+    ujson_size_t i;
+    if (ctx->config->repeat > 0)
+    {
+        width += ctx->depth * (ujson_size_t)ctx->config->repeat;
+    }
+    if (ctx->indent.body == NULL)
+    {
+        if (ujson_mbuf_init(&ctx->indent) != 0)
+        {
+            return -1;
+        }
+        ctx->indent.body[0] = '\n';
+        ctx->indent.size = 1;
+    }
+    if (ctx->indent.size < width)
+    {
+        if (ujson_mbuf_reserve(&ctx->indent, width - ctx->indent.size) != 0)
+        {
+            return -1;
+        }
+        for (i = ctx->indent.size; i != width; i++)
+        {
+            ctx->indent.body[i] = ctx->config->replacer;
+        }
+        ctx->indent.size = width;
+    }
+    return ujson_mbuf_append(ctx->mbuf, ctx->indent.body, width);
+}
+
+static int ujson_stringify_value_array(ujson_stringify_ctx_t* ctx,
+                                       const ujson_t* ujson)
+{
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    int first = 1;
+    ujson_array_item_t* item_cur;
+    if (ujson_mbuf_append(mbuf, "[", 1) != 0)
+    {
+        return -1;
+    }
+    ctx->depth++;
+    UJSON_SDT(ujson_sdt_reach(&ctx->max_depth, ctx->depth));
+    item_cur = ujson->u.part_array.begin;
+    while (item_cur != NULL)
+    {
+        if (first == 1)
+        {
+            first = 0;
+        }
+        else
+        {
+            if (ujson_mbuf_append(mbuf, ",", 1) != 0)
             {
                 return -1;
             }
-            p++;
-            len--;
-            break;
-        default:
-            if (IS_HYPER_ID(*p))
+        }
+        if ((ctx->pretty == ujson_true) && (ujson_stringify_newline(ctx) != 0))
+        {
+            return -1;
+        }
+        if (ujson_stringify_value(ctx, item_cur->value) != 0)
+        {
+            return -1;
+        }
+        item_cur = item_cur->next;
+    }
+    ctx->depth--;
+    /* Empty arrays stay on one line */
+    if ((ctx->pretty == ujson_true) && (first == 0) &&
+        (ujson_stringify_newline(ctx) != 0))
+    {
+        return -1;
+    }
+    if (ujson_mbuf_append(mbuf, "]", 1) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int ujson_stringify_object_member(ujson_stringify_ctx_t* ctx,
+                                         const ujson_object_item_t* item,
+                                         ujson_bool first)
+{
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    if ((first == ujson_false) && (ujson_mbuf_append(mbuf, ",", 1) != 0))
+    {
+        return -1;
+    }
+    if ((ctx->pretty == ujson_true) && (ujson_stringify_newline(ctx) != 0))
+    {
+        return -1;
+    }
+    if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
+    {
+        return -1;
+    }
+    if (ujson_stringify_string_body_ex(
+            mbuf, item->key.s, item->key.len, ctx->config->ascii_only,
+            (ctx->config->canonical == ujson_true) ? ujson_false
+                                                   : ujson_true) != 0)
+    {
+        return -1;
+    }
+    if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
+    {
+        return -1;
+    }
+    if (ujson_mbuf_append(mbuf, ": ", (ctx->pretty == ujson_true) ? 2 : 1) !=
+        0)
+    {
+        return -1;
+    }
+    if (ujson_stringify_value(ctx, item->value) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* Order of two UTF-8 keys by their UTF-16 code units (RFC 8785) */
+static int ujson_key_compare(const char* s1, ujson_size_t len1,
+                             const char* s2, ujson_size_t len2)
+{
+    const unsigned char* p1 = (const unsigned char*)s1;
+    const unsigned char* p2 = (const unsigned char*)s2;
+    ujson_size_t len = (len1 < len2) ? len1 : len2;
+    ujson_size_t i = 0;
+    while ((i != len) && (p1[i] == p2[i]))
+    {
+        i++;
+    }
+    if (i == len)
+    {
+        return (len1 == len2) ? 0 : ((len1 < len2) ? -1 : 1);
+    }
+    /* UTF-8 bytes order like code points, but code points past U+FFFF are
+     * surrogates in UTF-16 and sort before U+E000..U+FFFF */
+    if ((p1[i] >= 0xf0) && (0xee <= p2[i]) && (p2[i] <= 0xef))
+    {
+        return -1;
+    }
+    if ((p2[i] >= 0xf0) && (0xee <= p1[i]) && (p1[i] <= 0xef))
+    {
+        return 1;
+    }
+    return (p1[i] < p2[i]) ? -1 : 1;
+}
+
+/* Stable bottom-up merge sort of object members by key */
+static void ujson_object_items_sort(ujson_object_item_t** items,
+                                    ujson_object_item_t** scratch,
+                                    ujson_size_t count)
+{
+    ujson_object_item_t** src = items;
+    ujson_object_item_t** dst = scratch;
+    ujson_object_item_t** tmp;
+    ujson_size_t width, lo, mid, hi, i, j, k;
+    for (width = 1; width < count; width *= 2)
+    {
+        for (lo = 0; lo < count; lo += 2 * width)
+        {
+            mid = (lo + width < count) ? lo + width : count;
+            hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+            i = lo;
+            j = mid;
+            for (k = lo; k != hi; k++)
             {
-                bytes_number = id_hyper_length(*p);
-                if (len < bytes_number)
-                {
-                    return -1;
-                }
-                if (ujson_mbuf_append(mbuf, p, bytes_number) != 0)
+                if ((j == hi) ||
+                    ((i != mid) &&
+                     (ujson_key_compare(src[i]->key.s, src[i]->key.len,
+                                        src[j]->key.s, src[j]->key.len) <= 0)))
                 {
-                    return -1;
+                    dst[k] = src[i++];
                 }
-                p += bytes_number;
-                len -= bytes_number;
-            }
-            else
-            {
-                if (ujson_mbuf_append(mbuf, p, 1) != 0)
+                else
                 {
-                    return -1;
+                    dst[k] = src[j++];
                 }
-                p++;
-                len--;
             }
-            break;
         }
+        tmp = src;
+        src = dst;
+        dst = tmp;
     }
-    if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
+    if (src != items)
+    {
+        ujson_memcpy(items, src, sizeof(ujson_object_item_t*) * count);
+    }
+}
+
+static int ujson_stringify_sorted_reserve(ujson_stringify_ctx_t* ctx,
+                                          ujson_size_t count)
+{
+    ujson_object_item_t** new_sorted;
+    ujson_size_t new_capacity;
+    if (ctx->sorted_size + count <= ctx->sorted_capacity)
+    {
+        return 0;
+    }
+    new_capacity = ctx->sorted_capacity * 2;
+    if (new_capacity < ctx->sorted_size + count + 64)
+    {
+        new_capacity = ctx->sorted_size + count + 64;
+    }
+    if ((new_sorted = (ujson_object_item_t**)ujson_malloc(
+             sizeof(ujson_object_item_t*) * new_capacity)) == NULL)
     {
         return -1;
     }
+    if (ctx->sorted != NULL)
+    {
+        ujson_memcpy(new_sorted, ctx->sorted,
+                     sizeof(ujson_object_item_t*) * ctx->sorted_size);
+        ujson_free(ctx->sorted);
+    }
+    ctx->sorted = new_sorted;
+    ctx->sorted_capacity = new_capacity;
     return 0;
 }
 
-static int ujson_stringify_value_array(ujson_mbuf_t* mbuf, const ujson_t* ujson)
+/* Members in key order through a view on the context stack; the object
+ * itself is left as it is */
+static int ujson_stringify_value_object_sorted(ujson_stringify_ctx_t* ctx,
+                                               const ujson_t* ujson)
 {
-    int first = 1;
-    ujson_array_item_t* item_cur;
-    if (ujson_mbuf_append(mbuf, "[", 1) != 0)
+    ujson_size_t base = ctx->sorted_size;
+    ujson_size_t count = 0;
+    ujson_size_t i;
+    ujson_object_item_t* item_cur;
+    int ret = -1;
+    for (item_cur = ujson->u.part_object.begin; item_cur != NULL;
+         item_cur = item_cur->next)
+    {
+        count++;
+    }
+    /* The members and room to merge them */
+    if (ujson_stringify_sorted_reserve(ctx, count * 2) != 0)
     {
         return -1;
     }
-    item_cur = ujson->u.part_array.begin;
-    while (item_cur != NULL)
+    for (i = 0, item_cur = ujson->u.part_object.begin; item_cur != NULL;
+         i++, item_cur = item_cur->next)
     {
-        if (first == 1)
-        {
-            first = 0;
-        }
-        else
-        {
-            if (ujson_mbuf_append(mbuf, ",", 1) != 0)
-            {
-                return -1;
-            }
-        }
-        if (ujson_stringify_value(mbuf, item_cur->value) != 0)
+        ctx->sorted[base + i] = item_cur;
+    }
+    ujson_object_items_sort(ctx->sorted + base, ctx->sorted + base + count,
+                            count);
+    ctx->sorted_size = base + count;
+    if (ujson_mbuf_append(ctx->mbuf, "{", 1) != 0)
+    {
+        goto fail;
+    }
+    ctx->depth++;
+    UJSON_SDT(ujson_sdt_reach(&ctx->max_depth, ctx->depth));
+    for (i = 0; i != count; i++)
+    {
+        /* Nested objects may move the stack */
+        if (ujson_stringify_object_member(
+                ctx, ctx->sorted[base + i],
+                (i == 0) ? ujson_true : ujson_false) != 0)
         {
-            return -1;
+            goto fail;
         }
-        item_cur = item_cur->next;
     }
-    if (ujson_mbuf_append(mbuf, "]", 1) != 0)
+    ctx->depth--;
+    if ((ctx->pretty == ujson_true) && (count != 0) &&
+        (ujson_stringify_newline(ctx) != 0))
     {
-        return -1;
+        goto fail;
     }
-    return 0;
+    if (ujson_mbuf_append(ctx->mbuf, "}", 1) != 0)
+    {
+        goto fail;
+    }
+    ret = 0;
+fail:
+    ctx->sorted_size = base;
+    return ret;
 }
 
-static int ujson_stringify_value_object(ujson_mbuf_t* mbuf,
+static int ujson_stringify_value_object(ujson_stringify_ctx_t* ctx,
                                         const ujson_t* ujson)
 {
-    int first = 1;
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    ujson_bool first = ujson_true;
     ujson_object_item_t* item_cur;
+    if (ctx->config->canonical == ujson_true)
+    {
+        return ujson_stringify_value_object_sorted(ctx, ujson);
+    }
     if (ujson_mbuf_append(mbuf, "{", 1) != 0)
     {
         return -1;
     }
+    ctx->depth++;
+    UJSON_SDT(ujson_sdt_reach(&ctx->max_depth, ctx->depth));
     item_cur = ujson->u.part_object.begin;
     while (item_cur != NULL)
     {
-        if (first == 1)
-        {
-            first = 0;
-        }
-        else
-        {
-            if (ujson_mbuf_append(mbuf, ",", 1) != 0)
-            {
-                return -1;
-            }
-        }
-        if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
-        {
-            return -1;
-        }
-        if (ujson_mbuf_append(mbuf, item_cur->key.s, item_cur->key.len) != 0)
-        {
-            return -1;
-        }
-        if (ujson_mbuf_append(mbuf, "\"", 1) != 0)
-        {
-            return -1;
-        }
-        if (ujson_mbuf_append(mbuf, ":", 1) != 0)
+        if (ujson_stringify_object_member(ctx, item_cur, first) != 0)
         {
             return -1;
         }
-        if (ujson_stringify_value(mbuf, item_cur->value) != 0)
+        first = ujson_false;
+        item_cur = item_cur->next;
+    }
+    ctx->depth--;
+    /* Empty objects stay on one line */
+    if ((ctx->pretty == ujson_true) && (first == ujson_false) &&
+        (ujson_stringify_newline(ctx) != 0))
+    {
+        return -1;
+    }
+    if (ujson_mbuf_append(mbuf, "}", 1) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* The cache is not part of the value, so const nodes still keep it */
+static int ujson_stringify_value_cached(ujson_stringify_ctx_t* ctx,
+                                        const ujson_t* ujson)
+{
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    ujson_t* container = (ujson_t*)ujson;
+    ujson_fragment_t** fragment = ujson_fragment_of(container);
+    ujson_size_t start = mbuf->size;
+    ujson_size_t len;
+    if ((container->clean != 0) && (*fragment != NULL) &&
+        (container->mode == (unsigned int)ctx->cache_mode))
+    {
+        return ujson_mbuf_append(mbuf, ujson_fragment_body(*fragment),
+                                 (*fragment)->len);
+    }
+    if (ujson->type == UJSON_ARRAY)
+    {
+        if (ujson_stringify_value_array(ctx, ujson) != 0)
         {
             return -1;
         }
-        item_cur = item_cur->next;
     }
-    if (ujson_mbuf_append(mbuf, "}", 1) != 0)
+    else if (ujson_stringify_value_object(ctx, ujson) != 0)
     {
         return -1;
     }
+    ujson_fragment_free(container);
+    /* Without memory to keep it the output is only written again */
+    len = mbuf->size - start;
+    if ((len >= UJSON_FRAGMENT_MIN_SIZE) &&
+        ((*fragment = (ujson_fragment_t*)ujson_malloc(
+              sizeof(ujson_fragment_t) + sizeof(char) * len)) != NULL))
+    {
+        ujson_memcpy(ujson_fragment_body(*fragment), mbuf->body + start, len);
+        (*fragment)->len = len;
+    }
+    container->mode = (unsigned int)ctx->cache_mode;
+    container->clean = 1;
     return 0;
 }
 
-static int ujson_stringify_value(ujson_mbuf_t* mbuf, const ujson_t* ujson)
+static int ujson_stringify_value(ujson_stringify_ctx_t* ctx,
+                                 const ujson_t* ujson)
 {
+    ujson_mbuf_t* mbuf = ctx->mbuf;
+    UJSON_SDT(ctx->nodes++);
     switch (ujson->type)
     {
     case UJSON_NULL:
@@ -1710,25 +6631,33 @@ static int ujson_stringify_value(ujson_mbuf_t* mbuf, const ujson_t* ujson)
         }
         break;
     case UJSON_NUMEBR:
-        if (ujson_stringify_value_number(mbuf, ujson) != 0)
+        if (ujson_stringify_value_number(ctx, ujson) != 0)
         {
             return -1;
         }
         break;
     case UJSON_STRING:
-        if (ujson_stringify_value_string(mbuf, ujson) != 0)
+        if (ujson_stringify_value_string(ctx, ujson) != 0)
         {
             return -1;
         }
         break;
     case UJSON_ARRAY:
-        if (ujson_stringify_value_array(mbuf, ujson) != 0)
+        if (ctx->cache == ujson_true)
+        {
+            return ujson_stringify_value_cached(ctx, ujson);
+        }
+        if (ujson_stringify_value_array(ctx, ujson) != 0)
         {
             return -1;
         }
         break;
     case UJSON_OBJECT:
-        if (ujson_stringify_value_object(mbuf, ujson) != 0)
+        if (ctx->cache == ujson_true)
+        {
+            return ujson_stringify_value_cached(ctx, ujson);
+        }
+        if (ujson_stringify_value_object(ctx, ujson) != 0)
         {
             return -1;
         }
@@ -1743,12 +6672,31 @@ int ujson_stringify_ex(char** json_str, ujson_size_t* json_str_len,
 {
     int ret = 0;
     ujson_mbuf_t mbuf;
-    (void)config;
+    ujson_stringify_ctx_t ctx;
     if (ujson_mbuf_init(&mbuf) != 0)
     {
         return -1;
     }
-    if (ujson_stringify_value(&mbuf, ujson) != 0)
+    ctx.mbuf = &mbuf;
+    ctx.config = config;
+    ctx.sorted = NULL;
+    ctx.sorted_size = 0;
+    ctx.sorted_capacity = 0;
+    ctx.scratch.body = NULL;
+    ctx.pretty = (config->style == UJSON_STRINGIFY_CONFIG_STYLE_INDENT)
+                     ? ujson_true
+                     : ujson_false;
+    ctx.depth = 0;
+    ctx.indent.body = NULL;
+    /* Indented output depends on the depth, so is not kept */
+    ctx.cache = ((config->cache == ujson_true) && (ctx.pretty == ujson_false))
+                    ? ujson_true
+                    : ujson_false;
+    ctx.cache_mode = ((config->ascii_only == ujson_true) ? 1 : 0) |
+                     ((config->canonical == ujson_true) ? 2 : 0);
+    UJSON_SDT(ctx.nodes = 0; ctx.max_depth = 0);
+    UJSON_PROBE2(stringify__start, ujson, config->style);
+    if (ujson_stringify_value(&ctx, ujson) != 0)
     {
         ret = -1;
         goto fail;
@@ -1759,10 +6707,28 @@ int ujson_stringify_ex(char** json_str, ujson_size_t* json_str_len,
         goto fail;
     }
 fail:
+    UJSON_PROBE4(stringify__done, ret, ujson_mbuf_size(&mbuf), ctx.nodes,
+                 ctx.max_depth);
+    if (ctx.sorted != NULL)
+    {
+        ujson_free(ctx.sorted);
+    }
+    ujson_mbuf_uninit(&ctx.scratch);
+    ujson_mbuf_uninit(&ctx.indent);
     ujson_mbuf_uninit(&mbuf);
     return ret;
 }
 
+void ujson_stringify_config_init(ujson_stringify_config_t* config)
+{
+    config->style = UJSON_STRINGIFY_CONFIG_STYLE_COMPACT;
+    config->repeat = 0;
+    config->replacer = 0;
+    config->ascii_only = ujson_false;
+    config->canonical = ujson_false;
+    config->cache = ujson_false;
+}
+
 /* Dump a JSON value and product a json string */
 int ujson_stringify(char** json_str, ujson_size_t* json_str_len,
                     const ujson_t* ujson)
@@ -1770,15 +6736,196 @@ int ujson_stringify(char** json_str, ujson_size_t* json_str_len,
     int ret;
     ujson_stringify_config_t config;
 
-    config.style = UJSON_STRINGIFY_CONFIG_STYLE_COMPACT;
-    config.replacer = 0;
-    config.repeat = 0;
+    ujson_stringify_config_init(&config);
 
     ret = ujson_stringify_ex(json_str, json_str_len, ujson, &config);
 
     return ret;
 }
 
+static int ujson_bind_stringify_object(ujson_mbuf_t* mbuf,
+                                       const ujson_bind_desc_t* desc,
+                                       const char* base)
+{
+    const ujson_bind_entry_t* entry;
+    const char* field;
+    ujson_size_t i;
+
+    if (ujson_mbuf_append(mbuf, "{", 1) != 0)
+    {
+        return -1;
+    }
+    for (i = 0; i != desc->size; i++)
+    {
+        entry = &desc->entries[i];
+        field = base + entry->offset;
+        /* The first key goes without its leading ',' */
+        if (ujson_mbuf_append(mbuf, entry->key_text + (i == 0 ? 1 : 0),
+                              entry->key_text_len - (i == 0 ? 1 : 0)) != 0)
+        {
+            return -1;
+        }
+        switch (entry->type)
+        {
+        case UJSON_BIND_INT:
+            if (ujson_stringify_number(mbuf, *(const int*)field, 0.0,
+                                       ujson_false) != 0)
+            {
+                return -1;
+            }
+            break;
+        case UJSON_BIND_DOUBLE:
+            if (ujson_stringify_number(mbuf, 0, *(const double*)field,
+                                       ujson_true) != 0)
+            {
+                return -1;
+            }
+            break;
+        case UJSON_BIND_BOOL:
+            if (*(const ujson_bool*)field == ujson_false)
+            {
+                if (ujson_mbuf_append(mbuf, "false", 5) != 0)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                if (ujson_mbuf_append(mbuf, "true", 4) != 0)
+                {
+                    return -1;
+                }
+            }
+            break;
+        case UJSON_BIND_STRING:
+            if (*(char* const*)field == NULL)
+            {
+                if (ujson_mbuf_append(mbuf, "null", 4) != 0)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                if ((ujson_mbuf_append(mbuf, "\"", 1) != 0) ||
+                    (ujson_stringify_string_body(
+                         mbuf, *(char* const*)field,
+                         ujson_strlen(*(char* const*)field)) != 0) ||
+                    (ujson_mbuf_append(mbuf, "\"", 1) != 0))
+                {
+                    return -1;
+                }
+            }
+            break;
+        case UJSON_BIND_OBJECT:
+            if (ujson_bind_stringify_object(mbuf, entry->nested, field) != 0)
+            {
+                return -1;
+            }
+            break;
+        }
+    }
+    if (ujson_mbuf_append(mbuf, "}", 1) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* Dump a C struct as a JSON object, fields in descriptor order */
+int ujson_bind_stringify(const ujson_bind_desc_t* desc, const void* struct_ptr,
+                         char** json_str, ujson_size_t* json_str_len)
+{
+    int ret = 0;
+    ujson_mbuf_t mbuf;
+    if (ujson_mbuf_init(&mbuf) != 0)
+    {
+        return -1;
+    }
+    if (ujson_bind_stringify_object(&mbuf, desc, (const char*)struct_ptr) !=
+        0)
+    {
+        ret = -1;
+        goto fail;
+    }
+    if (ujson_mbuf_extract(json_str, json_str_len, &mbuf) != 0)
+    {
+        ret = -1;
+        goto fail;
+    }
+fail:
+    ujson_mbuf_uninit(&mbuf);
+    return ret;
+}
+
+/* Heap bytes held by a value: nodes, items, owned strings and keys, hash
+ * indexes and cached output. Borrowed strings and source text a lazy
+ * value still points into are not counted */
+ujson_size_t ujson_memory_usage(const ujson_t* ujson)
+{
+    ujson_size_t usage = sizeof(ujson_t);
+    const ujson_array_item_t* array_item;
+    const ujson_object_item_t* object_item;
+
+    switch (ujson->type)
+    {
+    case UJSON_NULL:
+    case UJSON_BOOL:
+    case UJSON_NUMEBR:
+    case UJSON_UNDEFINED:
+        break;
+
+    case UJSON_STRING:
+        if ((ujson->u.part_string.borrowed == 0) &&
+            (ujson->u.part_string.lazy == 0) &&
+            (ujson->u.part_string.s != NULL))
+        {
+            usage += ujson->u.part_string.len + 1;
+        }
+        break;
+
+    case UJSON_ARRAY:
+        for (array_item = ujson->u.part_array.begin; array_item != NULL;
+             array_item = array_item->next)
+        {
+            usage += sizeof(ujson_array_item_t) +
+                     ujson_memory_usage(array_item->value);
+        }
+        if (ujson->u.part_array.fragment != NULL)
+        {
+            usage += sizeof(ujson_fragment_t) +
+                     ujson->u.part_array.fragment->len;
+        }
+        break;
+
+    case UJSON_OBJECT:
+        for (object_item = ujson->u.part_object.begin; object_item != NULL;
+             object_item = object_item->next)
+        {
+            usage += sizeof(ujson_object_item_t) +
+                     ujson_memory_usage(object_item->value);
+            if ((object_item->key.owned == ujson_true) ||
+                (ujson_object_item_key_inline(object_item) == ujson_true))
+            {
+                usage += object_item->key.len + 1;
+            }
+        }
+        if (ujson->u.part_object.index != NULL)
+        {
+            usage += sizeof(ujson_object_index_t) +
+                     sizeof(ujson_object_item_t*) *
+                         ujson->u.part_object.index->size;
+        }
+        if (ujson->u.part_object.fragment != NULL)
+        {
+            usage += sizeof(ujson_fragment_t) +
+                     ujson->u.part_object.fragment->len;
+        }
+        break;
+    }
+    return usage;
+}
+
 static void ujson_destroy_value_array(ujson_t* ujson)
 {
     ujson_array_item_t *item_cur, *item_next;
@@ -1805,10 +6952,15 @@ static void ujson_destroy_value_object(ujson_t* ujson)
 
         item_cur = item_next;
     }
+    if (ujson->u.part_object.index != NULL)
+    {
+        ujson_free(ujson->u.part_object.index);
+    }
 }
 
 static void ujson_destroy_value(ujson_t* ujson)
 {
+    UJSON_STATS_UPDATE(g_ujson_stats.nodes[ujson->type]--);
     switch (ujson->type)
     {
     case UJSON_NULL:
@@ -1818,7 +6970,17 @@ static void ujson_destroy_value(ujson_t* ujson)
         break;
 
     case UJSON_STRING:
-        if (ujson->u.part_string.s != NULL)
+        if (ujson->u.part_string.borrowed != 0)
+        {
+            if ((ujson->u.part_string.release != NULL) &&
+                (ujson->u.part_string.s != NULL))
+            {
+                ujson->u.part_string.release(ujson->u.part_string.s);
+            }
+        }
+        /* A lazy span points into the source */
+        else if ((ujson->u.part_string.s != NULL) &&
+                 (ujson->u.part_string.lazy == 0))
         {
             ujson_free(ujson->u.part_string.s);
         }
@@ -1826,13 +6988,20 @@ static void ujson_destroy_value(ujson_t* ujson)
 
     case UJSON_ARRAY:
         ujson_destroy_value_array(ujson);
+        ujson_fragment_free(ujson);
         break;
 
     case UJSON_OBJECT:
         ujson_destroy_value_object(ujson);
+        ujson_fragment_free(ujson);
         break;
     }
-    ujson_free(ujson);
+    ujson_pool_free(UJSON_POOL_NODE, ujson);
 }
 
-void ujson_destroy(ujson_t* ujson) { ujson_destroy_value(ujson); }
+void ujson_destroy(ujson_t* ujson)
+{
+    UJSON_PROBE2(destroy__start, ujson, ujson->type);
+    ujson_destroy_value(ujson);
+    UJSON_PROBE(destroy__done);
+}
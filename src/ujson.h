@@ -56,6 +56,13 @@ typedef unsigned int ujson_size_t;
     void ujson_allocator_set_malloc(ujson_malloc_cb_t cb);
     void ujson_allocator_set_free(ujson_free_cb_t cb);
 
+    /* Built with UJSON_ENABLE_POOL (make POOL=1), values and container
+     * items are kept for reuse once destroyed instead of being freed.
+     * Give all of them back to the allocator; no value may be alive and
+     * no other thread may be using the library. Does nothing in other
+     * builds */
+    void ujson_pool_release(void);
+
     /* Create data structure */
 
     ujson_t* ujson_new_integer(int value);
@@ -64,6 +71,12 @@ typedef unsigned int ujson_size_t;
     ujson_t* ujson_new_null(void);
     ujson_t* ujson_new_undefined(void);
     ujson_t* ujson_new_string(char* s, ujson_size_t len);
+    /* Take s as already decoded text: copied as is, or borrowed without
+     * a copy and given to release (if any) when the node is destroyed.
+     * A borrowed body needs no terminator */
+    ujson_t* ujson_new_string_raw(const char* s, ujson_size_t len);
+    ujson_t* ujson_new_string_ref(char* s, ujson_size_t len,
+                                  ujson_free_cb_t release);
 
     ujson_array_item_t* ujson_array_item_new(ujson_t* element);
     void ujson_array_item_destroy(ujson_array_item_t* item);
@@ -75,6 +88,35 @@ typedef unsigned int ujson_size_t;
     ujson_t* ujson_new_object(void);
     int ujson_object_push_back(ujson_t* object, ujson_object_item_t* new_item);
 
+    /* Set a member from key bytes, replacing the value of an existing
+     * member with the same key; a new member costs a single allocation.
+     * The nocopy variant borrows key, which must outlive the object. A
+     * NULL value, or one that is the replaced value or lies inside it, is
+     * refused. On failure the caller keeps ownership of value */
+    int ujson_object_set(ujson_t* object, const char* key, ujson_size_t len,
+                         ujson_t* value);
+    int ujson_object_set_nocopy(ujson_t* object, char* key, ujson_size_t len,
+                                ujson_t* value);
+    /* Size the hash index of an object for count members */
+    int ujson_object_reserve(ujson_t* object, ujson_size_t count);
+
+    /* Mutation */
+
+    /* Edit containers in place; removed and replaced values are destroyed.
+     * Inserting at the size of an array appends, and removing or replacing
+     * a missing key fails, as does replacing a value with itself or with
+     * a value inside it */
+    int ujson_array_insert_at(ujson_t* array, ujson_size_t index,
+                              ujson_array_item_t* new_item);
+    int ujson_array_remove_at(ujson_t* array, ujson_size_t index);
+    int ujson_object_remove(ujson_t* object, const char* key,
+                            ujson_size_t len);
+    int ujson_object_replace(ujson_t* object, const char* key,
+                             ujson_size_t len, ujson_t* value);
+    /* Exchange the contents of two values, wherever they are held; fails
+     * when one of them holds the other */
+    int ujson_swap(ujson_t* ujson1, ujson_t* ujson2);
+
     /* Inspector */
 
     ujson_type_t ujson_type(ujson_t* ujson);
@@ -101,10 +143,117 @@ typedef unsigned int ujson_size_t;
     ujson_t* ujson_as_object_lookup(ujson_t* object, char* name,
                                     ujson_size_t len);
 
+    /* JSON Pointer (RFC 6901), compiled once and evaluated many times */
+
+    struct ujson_pointer;
+    typedef struct ujson_pointer ujson_pointer_t;
+
+    ujson_pointer_t* ujson_pointer_compile(const char* s, ujson_size_t len);
+    ujson_t* ujson_pointer_get(ujson_t* ujson, const ujson_pointer_t* ptr);
+    void ujson_pointer_destroy(ujson_pointer_t* ptr);
+
+    /* Apply a JSON Patch (RFC 6902) or JSON Merge Patch (RFC 7396) to doc
+     * in place. Values taken from the patch are copied, moved values are
+     * relinked; operations before a failing one stay applied */
+    int ujson_patch_apply(ujson_t* doc, ujson_t* patch);
+    int ujson_merge_patch_apply(ujson_t* doc, ujson_t* patch);
+
     /* Parse a JSON string and generate a JSON value */
 
     ujson_t* ujson_parse(char* s, ujson_size_t len);
 
+    /* Parse configure */
+
+    typedef struct
+    {
+        /* Keep number lexemes and convert them on first access; they are
+         * written back verbatim, and the input must outlive the value */
+        ujson_bool lazy_number;
+        /* Keep strings escaped and decode them on first access; they are
+         * written back verbatim, and the input must outlive the value */
+        ujson_bool lazy_string;
+        /* Parse a large top-level array on up to this many threads; the
+         * allocator must be thread-safe. Needs UJSON_ENABLE_PTHREAD */
+        int threads;
+        /* The input is followed by UJSON_PADDING readable zero bytes */
+        ujson_bool padded;
+    } ujson_parse_config_t;
+
+    /* Parse a JSON string and generate a JSON value (with config) */
+    ujson_t* ujson_parse_ex(char* s, ujson_size_t len,
+                            ujson_parse_config_t* config);
+
+    /* Parse a JSON string followed by UJSON_PADDING readable zero bytes;
+     * the scanners stop at the zero sentinel instead of checking the
+     * length of every byte, and read words past the end of the input */
+
+#define UJSON_PADDING 64
+
+    ujson_t* ujson_parse_padded(char* s, ujson_size_t len);
+
+    /* Check that a JSON string is valid (RFC 8259, strict UTF-8) without
+     * allocating; on failure err_offset receives the offending byte.
+     * undefined is rejected and nesting is limited to 1024 levels. Plain
+     * ASCII is checked a machine word at a time, without SIMD; any other
+     * text goes one UTF-8 sequence at a time, several times slower */
+    int ujson_validate(char* s, ujson_size_t len, ujson_size_t* err_offset);
+
+    /* Parse only the selected paths ("user.id", "tags[*]", "items[0].name")
+     * of an array or object; everything else is skipped without being
+     * built and containers left empty are dropped */
+
+    struct ujson_project;
+    typedef struct ujson_project ujson_project_t;
+
+    ujson_project_t* ujson_project_compile(const char** paths,
+                                           ujson_size_t count);
+    void ujson_project_destroy(ujson_project_t* project);
+    ujson_t* ujson_parse_project(char* s, ujson_size_t len,
+                                 const ujson_project_t* project);
+
+    /* Bind JSON objects directly to C structs, described by a table of
+     * fields. Strings are allocated with the ujson allocator and released
+     * by ujson_bind_free, nested objects are embedded structs */
+
+    typedef enum
+    {
+        UJSON_BIND_INT = 0,
+        UJSON_BIND_DOUBLE,
+        UJSON_BIND_BOOL,
+        UJSON_BIND_STRING,
+        UJSON_BIND_OBJECT,
+    } ujson_bind_type_t;
+
+    struct ujson_bind_desc;
+    typedef struct ujson_bind_desc ujson_bind_desc_t;
+
+    typedef struct
+    {
+        const char* name;
+        ujson_size_t offset;
+        ujson_bind_type_t type;
+        const ujson_bind_desc_t* nested;
+    } ujson_bind_field_t;
+
+    ujson_bind_desc_t* ujson_bind_desc_new(const ujson_bind_field_t* fields,
+                                           ujson_size_t count);
+    void ujson_bind_desc_destroy(ujson_bind_desc_t* desc);
+
+    /* Decode a JSON object into a struct; unknown keys are skipped and
+     * absent or null members leave their fields untouched. A string
+     * field that is not NULL is released before it is replaced, so the
+     * struct must be zero-initialized or hold only strings from an
+     * earlier ujson_bind_parse */
+    int ujson_bind_parse(const ujson_bind_desc_t* desc, void* struct_ptr,
+                         char* s, ujson_size_t len);
+    void ujson_bind_free(const ujson_bind_desc_t* desc, void* struct_ptr);
+
+    /* Dump a struct as a JSON object with the keys escaped at descriptor
+     * build time; NULL strings are written as null */
+    int ujson_bind_stringify(const ujson_bind_desc_t* desc,
+                             const void* struct_ptr, char** json_str,
+                             ujson_size_t* json_str_len);
+
     /* Configure */
 
     typedef enum
@@ -118,8 +267,23 @@ typedef unsigned int ujson_size_t;
         ujson_stringify_config_style_t style;
         int repeat;
         char replacer;
+        /* Escape every non-ASCII code point as \uXXXX (surrogate pairs
+         * past U+FFFF) for 7-bit clean output */
+        ujson_bool ascii_only;
+        /* Canonical form (RFC 8785): members sorted by key without
+         * touching the tree, shortest round-trip numbers and only the
+         * escapes JSON requires */
+        ujson_bool canonical;
+        /* Compact output only: arrays and objects keep what they were
+         * written as and reuse it until changed through this API, so a
+         * large document is written again at the cost of its edits */
+        ujson_bool cache;
     } ujson_stringify_config_t;
 
+    /* Compact output with every option off. Start from this instead of
+     * setting fields one by one, so options added later stay off */
+    void ujson_stringify_config_init(ujson_stringify_config_t* config);
+
     /* Dump a JSON value and product a json string (with config) */
     int ujson_stringify_ex(char** json_str, ujson_size_t* json_str_len,
                            const ujson_t* ujson,
@@ -129,9 +293,47 @@ typedef unsigned int ujson_size_t;
     int ujson_stringify(char** json_str, ujson_size_t* json_str_len,
                         const ujson_t* ujson);
 
+    /* Rewrite the whitespace of a JSON string without building values:
+     * tokens are copied as they are and handed to write in chunks, in
+     * constant memory. Only style, repeat and replacer apply; write
+     * returns 0 on success, and output may be partial on failure */
+
+    typedef int (*ujson_write_cb_t)(void* data, const char* s,
+                                    ujson_size_t len);
+
+    int ujson_reformat(char* s, ujson_size_t len,
+                       const ujson_stringify_config_t* config,
+                       ujson_write_cb_t write, void* data);
+    int ujson_minify(char* s, ujson_size_t len, ujson_write_cb_t write,
+                     void* data);
+
     /* Destroy JSON value */
     void ujson_destroy(ujson_t* ujson);
 
+    /* Heap bytes held by a value and everything under it */
+    ujson_size_t ujson_memory_usage(const ujson_t* ujson);
+
+    /* Process-wide allocation counters, kept when built with
+     * UJSON_ENABLE_STATS (make STATS=1) and all zero otherwise. Strings
+     * returned to the caller count as allocated but not as in use, since
+     * the caller frees them */
+    typedef struct
+    {
+        /* Live values by type */
+        ujson_size_t nodes[UJSON_OBJECT + 1];
+        ujson_size_t allocations;
+        ujson_size_t frees;
+        ujson_size_t bytes_allocated;
+        ujson_size_t bytes_in_use;
+        ujson_size_t peak_bytes;
+        /* Output and scratch buffers grown past their first block */
+        ujson_size_t mbuf_regrowths;
+    } ujson_stats_t;
+
+    void ujson_stats_get(ujson_stats_t* stats);
+    /* Clear the cumulative counters; the peak restarts from bytes in use */
+    void ujson_stats_reset(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,11 @@
+#include "test_bind.h"
 #include "test_construct.h"
+#include "test_patch.h"
+#include "test_pointer.h"
+#include "test_project.h"
+#include "test_reformat.h"
 #include "test_reverse.h"
+#include "test_validate.h"
 #include "ujson.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,5 +17,11 @@ int main(void)
     ujson_allocator_set_free(free);
     test_reverse();
     test_construct();
+    test_pointer();
+    test_project();
+    test_bind();
+    test_validate();
+    test_reformat();
+    test_patch();
     return 0;
 }
@@ -0,0 +1,155 @@
+#include "test_bind.h"
+#include "ujson.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    int id;
+    char* name;
+} test_bind_user_t;
+
+typedef struct
+{
+    double ts;
+    ujson_bool ok;
+    test_bind_user_t user;
+} test_bind_event_t;
+
+static const ujson_bind_field_t test_bind_user_fields[] = {
+    {"id", offsetof(test_bind_user_t, id), UJSON_BIND_INT, NULL},
+    {"name", offsetof(test_bind_user_t, name), UJSON_BIND_STRING, NULL},
+};
+
+#define TEST_ONE_BIND(cond)                                                    \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s bind test failed\n", __FILE__,  \
+                    __LINE__, #cond);                                          \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+static int test_bind_event_stringify(ujson_bind_desc_t* desc,
+                                     test_bind_event_t* event, char* expect_s)
+{
+    int ret = 0;
+    char* json_str = NULL;
+    ujson_size_t json_str_len;
+
+    if (ujson_bind_stringify(desc, event, &json_str, &json_str_len) != 0)
+    {
+        return -1;
+    }
+    if ((json_str_len != strlen(expect_s)) ||
+        (strncmp(expect_s, json_str, json_str_len) != 0))
+    {
+        ret = -1;
+    }
+    free(json_str);
+    return ret;
+}
+
+static int test_bind_event_parse(ujson_bind_desc_t* desc,
+                                 test_bind_event_t* event, char* s)
+{
+    memset(event, 0, sizeof(*event));
+    return ujson_bind_parse(desc, event, s, strlen(s));
+}
+
+int test_bind(void)
+{
+    int total = 0;
+    int passed = 0;
+    ujson_bind_desc_t* user_desc;
+    ujson_bind_desc_t* event_desc;
+    test_bind_event_t event;
+
+    user_desc = ujson_bind_desc_new(test_bind_user_fields, 2);
+    {
+        ujson_bind_field_t event_fields[] = {
+            {"ts", offsetof(test_bind_event_t, ts), UJSON_BIND_DOUBLE, NULL},
+            {"ok", offsetof(test_bind_event_t, ok), UJSON_BIND_BOOL, NULL},
+            {"user", offsetof(test_bind_event_t, user), UJSON_BIND_OBJECT,
+             NULL},
+        };
+        event_fields[2].nested = user_desc;
+        event_desc = ujson_bind_desc_new(event_fields, 3);
+    }
+
+    /* Parse */
+    TEST_ONE_BIND(test_bind_event_parse(
+                      event_desc, &event,
+                      " { \"ts\" : 1.5 , \"skip\" : [1, {\"a\": \"}\"}], "
+                      "\"ok\": true, \"user\": {\"name\": \"a\\\"b\", "
+                      "\"id\": -7} } ") == 0);
+    TEST_ONE_BIND(event.ts == 1.5);
+    TEST_ONE_BIND(event.ok == ujson_true);
+    TEST_ONE_BIND(event.user.id == -7);
+    TEST_ONE_BIND((event.user.name != NULL) &&
+                  (strcmp(event.user.name, "a\"b") == 0));
+    ujson_bind_free(event_desc, &event);
+    TEST_ONE_BIND(event.user.name == NULL);
+
+    /* Escaped keys, null and absent members */
+    TEST_ONE_BIND(test_bind_event_parse(
+                      event_desc, &event,
+                      "{\"\\u0075ser\":{\"id\":3,\"name\":null}}") == 0);
+    TEST_ONE_BIND((event.user.id == 3) && (event.user.name == NULL) &&
+                  (event.ok == ujson_false));
+    ujson_bind_free(event_desc, &event);
+
+    /* Errors */
+    TEST_ONE_BIND(test_bind_event_parse(event_desc, &event,
+                                        "{\"ok\":1}") != 0);
+    TEST_ONE_BIND(test_bind_event_parse(event_desc, &event,
+                                        "{\"user\":{\"id\":\"1\"}}") != 0);
+    TEST_ONE_BIND(test_bind_event_parse(event_desc, &event,
+                                        "{\"skip\":[1,}") != 0);
+    TEST_ONE_BIND(test_bind_event_parse(event_desc, &event, "[]") != 0);
+    ujson_bind_free(event_desc, &event);
+
+    /* Stringify */
+    memset(&event, 0, sizeof(event));
+    TEST_ONE_BIND(test_bind_event_stringify(
+                      event_desc, &event,
+                      "{\"ts\":0.000000000000,\"ok\":false,\"user\":{\"id\":0,"
+                      "\"name\":null}}") == 0);
+    event.ok = ujson_true;
+    event.user.id = -12;
+    event.user.name = "a\"\n";
+    TEST_ONE_BIND(test_bind_event_stringify(
+                      event_desc, &event,
+                      "{\"ts\":0.000000000000,\"ok\":true,\"user\":{\"id\":-12,"
+                      "\"name\":\"a\\\"\\n\"}}") == 0);
+    {
+        ujson_bind_field_t quoted_fields[] = {
+            {"a\"b", offsetof(test_bind_user_t, id), UJSON_BIND_INT, NULL},
+        };
+        ujson_bind_desc_t* quoted_desc = ujson_bind_desc_new(quoted_fields, 1);
+        char* json_str = NULL;
+        ujson_size_t json_str_len;
+        test_bind_user_t user;
+        user.id = 1;
+        TEST_ONE_BIND((ujson_bind_stringify(quoted_desc, &user, &json_str,
+                                            &json_str_len) == 0) &&
+                      (strcmp(json_str, "{\"a\\\"b\":1}") == 0));
+        free(json_str);
+        ujson_bind_desc_destroy(quoted_desc);
+    }
+
+    ujson_bind_desc_destroy(event_desc);
+    ujson_bind_desc_destroy(user_desc);
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
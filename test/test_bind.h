@@ -0,0 +1,6 @@
+#ifndef TEST_BIND_H
+#define TEST_BIND_H
+
+int test_bind(void);
+
+#endif
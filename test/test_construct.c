@@ -3,6 +3,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(UJSON_ENABLE_POOL) && defined(UJSON_ENABLE_PTHREAD)
+#include <pthread.h>
+#endif
 
 int test_one_construct(ujson_t* json, char* expect_s)
 {
@@ -50,6 +53,26 @@ fail:
         }                                                                      \
     } while (0);
 
+#if defined(UJSON_ENABLE_POOL) && defined(UJSON_ENABLE_PTHREAD)
+static void* test_construct_pool_build(void* data)
+{
+    ujson_t* u = ujson_new_array();
+    int i;
+    (void)data;
+    for (i = 0; i != 2000; i++)
+    {
+        ujson_array_push_back(u, ujson_array_item_new(ujson_new_integer(i)));
+    }
+    return u;
+}
+
+static void* test_construct_pool_destroy(void* data)
+{
+    ujson_destroy((ujson_t*)data);
+    return NULL;
+}
+#endif
+
 int test_construct(void)
 {
     int total = 0;
@@ -135,6 +158,24 @@ int test_construct(void)
         ujson_destroy(u);
     }
 
+    /* "a\"b" copied raw */
+    {
+        ujson_t* u;
+        u = ujson_new_string_raw("a\"b", 3);
+        TEST_ONE_CONSTRUCT(u, "\"a\\\"b\"");
+        ujson_destroy(u);
+    }
+
+    /* "\\n" borrowed, not unescaped */
+    {
+        ujson_t* u;
+        char* body = malloc(2);
+        memcpy(body, "\\n", 2);
+        u = ujson_new_string_ref(body, 2, free);
+        TEST_ONE_CONSTRUCT(u, "\"\\\\n\"");
+        ujson_destroy(u);
+    }
+
     /* [] */
     {
         ujson_t* u;
@@ -199,6 +240,433 @@ int test_construct(void)
         ujson_destroy(u);
     }
 
+    /* {"one":1,"two":22,"x":true} set by key */
+    {
+        ujson_t* u;
+        static char key_x[] = "x";
+        u = ujson_new_object();
+        ujson_object_set(u, "one", 3, ujson_new_integer(1));
+        ujson_object_set(u, "two", 3, ujson_new_integer(2));
+        ujson_object_set_nocopy(u, key_x, 1, ujson_new_bool(ujson_true));
+        ujson_object_set(u, "two", 3, ujson_new_integer(22));
+        TEST_ONE_CONSTRUCT(u, "{\"one\":1,\"two\":22,\"x\":true}");
+        ujson_destroy(u);
+    }
+
+    /* A member is not set to its own value or to one inside it */
+    {
+        ujson_t *u, *a, *seven;
+        u = ujson_new_object();
+        a = ujson_new_array();
+        seven = ujson_new_integer(7);
+        ujson_array_push_back(a, ujson_array_item_new(seven));
+        ujson_object_set(u, "a", 1, a);
+        total++;
+        if ((ujson_object_set(u, "a", 1, seven) == -1) &&
+            (ujson_object_set(u, "a", 1, a) == -1) &&
+            (ujson_object_set(u, "b", 1, NULL) == -1))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: set to a child test failed\n",
+                    __FILE__, __LINE__);
+        }
+        TEST_ONE_CONSTRUCT(u, "{\"a\":[7]}");
+        ujson_destroy(u);
+    }
+
+    /* Indexed object with replaced members */
+    {
+        ujson_t* u;
+        char key[8];
+        int i;
+        u = ujson_new_object();
+        ujson_object_reserve(u, 4);
+        for (i = 0; i != 100; i++)
+        {
+            sprintf(key, "k%d", i % 50);
+            ujson_object_set(u, key, strlen(key), ujson_new_integer(i));
+        }
+        total++;
+        if ((ujson_as_integer_value(ujson_as_object_lookup(u, "k0", 2)) ==
+             50) &&
+            (ujson_as_integer_value(ujson_as_object_lookup(u, "k49", 3)) ==
+             99) &&
+            (ujson_as_object_lookup(u, "k50", 3) == NULL))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: indexed object test failed\n",
+                    __FILE__, __LINE__);
+        }
+        ujson_destroy(u);
+    }
+
+    /* Edited in place */
+    {
+        ujson_t *u, *a, *b;
+        char key[8];
+        int i;
+        u = ujson_new_object();
+        a = ujson_new_array();
+        for (i = 0; i != 10; i++)
+        {
+            sprintf(key, "k%d", i);
+            ujson_object_set(u, key, strlen(key), ujson_new_integer(i));
+        }
+        for (i = 1; i != 10; i++)
+        {
+            sprintf(key, "k%d", i);
+            ujson_object_remove(u, key, strlen(key));
+        }
+        ujson_object_replace(u, "k0", 2, ujson_new_bool(ujson_false));
+        ujson_array_push_back(a, ujson_array_item_new(ujson_new_integer(2)));
+        ujson_array_insert_at(a, 0, ujson_array_item_new(ujson_new_integer(0)));
+        ujson_array_insert_at(a, 1, ujson_array_item_new(ujson_new_integer(1)));
+        ujson_array_insert_at(a, 3, ujson_array_item_new(ujson_new_integer(3)));
+        ujson_array_remove_at(a, 2);
+        ujson_object_set(u, "a", 1, a);
+        b = ujson_new_null();
+        ujson_swap(b, ujson_as_object_lookup(u, "k0", 2));
+        ujson_destroy(b);
+        TEST_ONE_CONSTRUCT(u, "{\"k0\":null,\"a\":[0,1,3]}");
+        ujson_destroy(u);
+    }
+
+    /* A member is not replaced with its own child */
+    {
+        ujson_t *u, *a, *seven;
+        u = ujson_new_object();
+        a = ujson_new_array();
+        seven = ujson_new_integer(7);
+        ujson_array_push_back(a, ujson_array_item_new(seven));
+        ujson_object_set(u, "a", 1, a);
+        total++;
+        if ((ujson_object_replace(u, "a", 1, seven) == -1) &&
+            (ujson_object_replace(u, "a", 1, a) == -1) &&
+            (ujson_object_replace(u, "a", 1, NULL) == -1))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: replace with a child test failed\n",
+                    __FILE__, __LINE__);
+        }
+        TEST_ONE_CONSTRUCT(u, "{\"a\":[7]}");
+        ujson_destroy(u);
+    }
+
+    /* A value is not swapped with one it holds */
+    {
+        ujson_t *u, *a;
+        u = ujson_new_array();
+        a = ujson_new_array();
+        ujson_array_push_back(a, ujson_array_item_new(ujson_new_integer(1)));
+        ujson_array_push_back(a, ujson_array_item_new(ujson_new_integer(2)));
+        ujson_array_push_back(u, ujson_array_item_new(a));
+        total++;
+        if ((ujson_swap(u, a) == -1) && (ujson_swap(a, u) == -1))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: swap with a child test failed\n",
+                    __FILE__, __LINE__);
+        }
+        TEST_ONE_CONSTRUCT(u, "[[1,2]]");
+        ujson_destroy(u);
+    }
+
+    /* Cached output follows edits */
+    {
+        ujson_t *u, *a, *b;
+        ujson_stringify_config_t config;
+        char *json_str1 = NULL, *json_str2 = NULL;
+        ujson_size_t json_str_len1, json_str_len2;
+        int i, round, ok = 1;
+        ujson_stringify_config_init(&config);
+        config.cache = ujson_true;
+        u = ujson_new_object();
+        a = ujson_new_array();
+        b = ujson_new_array();
+        for (i = 0; i != 100; i++)
+        {
+            ujson_array_push_back(a, ujson_array_item_new(ujson_new_integer(i)));
+            ujson_array_push_back(b, ujson_array_item_new(ujson_new_integer(i)));
+        }
+        ujson_object_set(u, "a", 1, a);
+        ujson_object_set(u, "b", 1, b);
+        for (round = 0; round != 4; round++)
+        {
+            if (round == 1)
+            {
+                ujson_array_remove_at(a, 0);
+            }
+            else if (round == 2)
+            {
+                ujson_object_set(u, "c", 1, ujson_new_null());
+            }
+            else if (round == 3)
+            {
+                ujson_swap(ujson_as_object_lookup(u, "c", 1),
+                           ujson_as_array_item_value(ujson_as_array_first(b)));
+            }
+            config.cache = ujson_true;
+            ujson_stringify_ex(&json_str1, &json_str_len1, u, &config);
+            config.cache = ujson_false;
+            ujson_stringify_ex(&json_str2, &json_str_len2, u, &config);
+            if ((json_str1 == NULL) || (json_str2 == NULL) ||
+                (json_str_len1 != json_str_len2) ||
+                (strncmp(json_str1, json_str2, json_str_len1) != 0))
+            {
+                ok = 0;
+            }
+            free(json_str1);
+            free(json_str2);
+            json_str1 = json_str2 = NULL;
+        }
+        total++;
+        if (ok != 0)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: cached output test failed\n",
+                    __FILE__, __LINE__);
+        }
+        ujson_destroy(u);
+    }
+
+    /* Memory usage accounts for what a value holds */
+    {
+        ujson_t *u, *a;
+        ujson_size_t usage_empty, usage;
+        int i, ok = 1;
+        char key[16];
+        ujson_stringify_config_t config;
+        char* json_str;
+        ujson_size_t json_str_len;
+        ujson_stats_t stats_before, stats_after;
+        ujson_stats_get(&stats_before);
+        u = ujson_new_object();
+        usage_empty = ujson_memory_usage(u);
+        a = ujson_new_array();
+        for (i = 0; i != 20; i++)
+        {
+            sprintf(key, "k%d", i);
+            ujson_object_set(u, key, strlen(key), ujson_new_string("abc", 3));
+            ujson_array_push_back(a, ujson_array_item_new(ujson_new_null()));
+        }
+        ujson_object_set(u, "a", 1, a);
+        /* Kept output counts too */
+        ujson_stringify_config_init(&config);
+        config.cache = ujson_true;
+        ujson_stringify_ex(&json_str, &json_str_len, u, &config);
+        free(json_str);
+        usage = ujson_memory_usage(u);
+        if ((usage_empty == 0) || (usage <= usage_empty + 40 * 3 + 256))
+        {
+            ok = 0;
+        }
+        ujson_stats_get(&stats_after);
+#if defined(UJSON_ENABLE_STATS)
+        if (stats_after.nodes[UJSON_STRING] -
+                stats_before.nodes[UJSON_STRING] !=
+            20)
+        {
+            ok = 0;
+        }
+#if !defined(UJSON_ENABLE_POOL)
+        /* Pooled blocks stay allocated once destroyed */
+        if (stats_after.bytes_in_use - stats_before.bytes_in_use != usage)
+        {
+            ok = 0;
+        }
+#endif
+#else
+        /* Without counters they all read zero */
+        if ((stats_after.allocations != 0) || (stats_after.bytes_in_use != 0))
+        {
+            ok = 0;
+        }
+#endif
+        ujson_destroy(u);
+#if defined(UJSON_ENABLE_STATS) && !defined(UJSON_ENABLE_POOL)
+        ujson_stats_get(&stats_after);
+        if (stats_after.bytes_in_use != stats_before.bytes_in_use)
+        {
+            ok = 0;
+        }
+#endif
+        total++;
+        if (ok != 0)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: memory usage test failed\n",
+                    __FILE__, __LINE__);
+        }
+    }
+
+#if defined(UJSON_ENABLE_POOL)
+    /* Pooled values survive a release once all are gone */
+    {
+        ujson_t* u;
+        int i, round;
+        for (round = 0; round != 2; round++)
+        {
+            u = ujson_new_array();
+            for (i = 0; i != 1000; i++)
+            {
+                ujson_array_push_back(u, ujson_array_item_new(ujson_new_null()));
+            }
+            ujson_destroy(u);
+            ujson_pool_release();
+        }
+        u = ujson_new_object();
+        ujson_object_set(u, "a", 1, ujson_new_integer(1));
+        ujson_object_set_nocopy(u, "b", 1, ujson_new_integer(2));
+        TEST_ONE_CONSTRUCT(u, "{\"a\":1,\"b\":2}");
+        ujson_destroy(u);
+    }
+
+    /* Blocks held by parser threads are reused once they exit */
+    {
+        static const char element[] = "{\"k\":[1,2,\"v\"]}";
+        size_t element_len = sizeof(element) - 1;
+        size_t count = 20000;
+        ujson_parse_config_t config;
+        ujson_t* json;
+        char* s = malloc((element_len + 1) * count + 2);
+        char* p = s;
+        size_t i;
+        int round, ok = 1;
+#if defined(UJSON_ENABLE_STATS)
+        ujson_stats_t stats;
+        ujson_size_t in_use = 0;
+#endif
+        *p++ = '[';
+        for (i = 0; i != count; i++)
+        {
+            if (i != 0)
+                *p++ = ',';
+            memcpy(p, element, element_len);
+            p += element_len;
+        }
+        *p++ = ']';
+        memset(&config, 0, sizeof(config));
+        config.threads = 4;
+        for (round = 0; round != 20; round++)
+        {
+            if ((json = ujson_parse_ex(s, (ujson_size_t)(p - s), &config)) ==
+                NULL)
+            {
+                ok = 0;
+                break;
+            }
+            ujson_destroy(json);
+#if defined(UJSON_ENABLE_STATS)
+            /* Lost worker blocks grew this by ~55KB a round; only a few
+               slabs may still be taken while the batches even out */
+            ujson_stats_get(&stats);
+            if (round == 4)
+            {
+                in_use = stats.bytes_in_use;
+            }
+            else if ((round > 4) &&
+                     (stats.bytes_in_use > in_use + 64 * 1024))
+            {
+                ok = 0;
+            }
+#endif
+        }
+        total++;
+        if (ok != 0)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: pool reuse test failed\n",
+                    __FILE__, __LINE__);
+        }
+        free(s);
+    }
+
+#if defined(UJSON_ENABLE_PTHREAD)
+    /* Values built on one thread and destroyed on another */
+    {
+        pthread_t builder, destroyer;
+        void* u;
+        ujson_t* first;
+        int round, ok = 1;
+#if defined(UJSON_ENABLE_STATS)
+        ujson_stats_t stats;
+        ujson_size_t in_use = 0;
+#endif
+        /* Blocks left over from earlier cases would hide lost ones */
+        ujson_pool_release();
+        for (round = 0; round != 20; round++)
+        {
+            if ((pthread_create(&builder, NULL, test_construct_pool_build,
+                                NULL) != 0) ||
+                (pthread_join(builder, &u) != 0) || (u == NULL))
+            {
+                ok = 0;
+                break;
+            }
+            first = ujson_as_array_item_value(
+                ujson_as_array_first((ujson_t*)u));
+            if ((ujson_as_array_size((ujson_t*)u) != 2000) ||
+                (ujson_as_integer_value(first) != 0))
+            {
+                ok = 0;
+            }
+            if ((pthread_create(&destroyer, NULL, test_construct_pool_destroy,
+                                u) != 0) ||
+                (pthread_join(destroyer, NULL) != 0))
+            {
+                ok = 0;
+                break;
+            }
+#if defined(UJSON_ENABLE_STATS)
+            /* Each round takes ~140KB; what the destroying thread frees
+               must come back to the next builder */
+            ujson_stats_get(&stats);
+            if (round == 4)
+            {
+                in_use = stats.bytes_in_use;
+            }
+            else if ((round > 4) &&
+                     (stats.bytes_in_use > in_use + 64 * 1024))
+            {
+                ok = 0;
+            }
+#endif
+        }
+        total++;
+        if (ok != 0)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: pool cross-thread test failed\n",
+                    __FILE__, __LINE__);
+        }
+    }
+#endif
+#endif
+
     printf("%d of %d cases passed\n", passed, total);
 
     return 0;
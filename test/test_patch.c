@@ -0,0 +1,116 @@
+#include "test_patch.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* expect_s is NULL when the patch should be rejected */
+int test_one_patch(char* doc_s, char* patch_s, char* expect_s, int merge)
+{
+    int ret = 0;
+    ujson_t* doc = NULL;
+    ujson_t* patch = NULL;
+    char* json_str = NULL;
+    ujson_size_t json_str_len;
+
+    if (((doc = ujson_parse(doc_s, strlen(doc_s))) == NULL) ||
+        ((patch = ujson_parse(patch_s, strlen(patch_s))) == NULL))
+    {
+        ret = -1;
+        goto fail;
+    }
+    if (((merge != 0) ? ujson_merge_patch_apply(doc, patch)
+                      : ujson_patch_apply(doc, patch)) != 0)
+    {
+        ret = (expect_s == NULL) ? 0 : -1;
+        goto fail;
+    }
+    if ((expect_s == NULL) ||
+        (ujson_stringify(&json_str, &json_str_len, doc) != 0) ||
+        (json_str_len != strlen(expect_s)) ||
+        (strncmp(expect_s, json_str, json_str_len) != 0))
+    {
+        ret = -1;
+        goto fail;
+    }
+
+fail:
+    if (doc != NULL)
+        ujson_destroy(doc);
+    if (patch != NULL)
+        ujson_destroy(patch);
+    if (json_str != NULL)
+        free(json_str);
+    return ret;
+}
+
+#define TEST_ONE_PATCH(doc_s, patch_s, expect_s, merge)                        \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_patch(doc_s, patch_s, expect_s, merge) != 0)              \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s patch test failed\n",           \
+                    __FILE__, __LINE__, patch_s);                              \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+int test_patch(void)
+{
+    int total = 0, passed = 0;
+
+    /* JSON Patch */
+    TEST_ONE_PATCH("{\"a\":1}",
+                   "[{\"op\":\"add\",\"path\":\"/b\",\"value\":[1,2]},"
+                   "{\"op\":\"add\",\"path\":\"/b/1\",\"value\":3},"
+                   "{\"op\":\"add\",\"path\":\"/b/-\",\"value\":4}]",
+                   "{\"a\":1,\"b\":[1,3,2,4]}", 0);
+    TEST_ONE_PATCH("{\"a\":1,\"b\":[1,2],\"c\":{\"d\":true}}",
+                   "[{\"op\":\"remove\",\"path\":\"/a\"},"
+                   "{\"op\":\"remove\",\"path\":\"/b/0\"},"
+                   "{\"op\":\"replace\",\"path\":\"/c/d\",\"value\":false}]",
+                   "{\"b\":[2],\"c\":{\"d\":false}}", 0);
+    TEST_ONE_PATCH("{\"a\":{\"x\":[1]},\"b\":[]}",
+                   "[{\"op\":\"move\",\"from\":\"/a/x\",\"path\":\"/b/0\"},"
+                   "{\"op\":\"copy\",\"from\":\"/b\",\"path\":\"/a/y\"},"
+                   "{\"op\":\"test\",\"path\":\"/a/y\",\"value\":[[1]]}]",
+                   "{\"a\":{\"y\":[[1]]},\"b\":[[1]]}", 0);
+    TEST_ONE_PATCH("{\"a~b\":{\"c/d\":1}}",
+                   "[{\"op\":\"move\",\"from\":\"/a~0b/c~1d\",\"path\":\"\"}]",
+                   "1", 0);
+    TEST_ONE_PATCH("{\"a\":1}",
+                   "[{\"op\":\"test\",\"path\":\"/a\",\"value\":2}]", NULL, 0);
+    TEST_ONE_PATCH("{\"a\":{}}",
+                   "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b\"}]", NULL,
+                   0);
+    TEST_ONE_PATCH("[1]", "[{\"op\":\"add\",\"path\":\"/2\",\"value\":1}]",
+                   NULL, 0);
+    TEST_ONE_PATCH("{}", "[{\"op\":\"remove\",\"path\":\"/a\"}]", NULL, 0);
+    TEST_ONE_PATCH("{}", "[{\"op\":\"jump\",\"path\":\"/a\"}]", NULL, 0);
+    /* Strings differing only past an embedded NUL */
+    TEST_ONE_PATCH("{\"a\":\"x\\u0000y\"}",
+                   "[{\"op\":\"test\",\"path\":\"/a\","
+                   "\"value\":\"x\\u0000z\"}]",
+                   NULL, 0);
+    TEST_ONE_PATCH("{\"a\":\"x\\u0000y\"}",
+                   "[{\"op\":\"test\",\"path\":\"/a\","
+                   "\"value\":\"x\\u0000y\"}]",
+                   "{\"a\":\"x\\u0000y\"}", 0);
+
+    /* JSON Merge Patch */
+    TEST_ONE_PATCH("{\"a\":\"b\",\"c\":{\"d\":\"e\",\"f\":\"g\"}}",
+                   "{\"a\":\"z\",\"c\":{\"f\":null}}",
+                   "{\"a\":\"z\",\"c\":{\"d\":\"e\"}}", 1);
+    TEST_ONE_PATCH("{\"a\":[1]}", "{\"a\":{\"b\":{\"c\":null,\"d\":1}}}",
+                   "{\"a\":{\"b\":{\"d\":1}}}", 1);
+    TEST_ONE_PATCH("{\"a\":1}", "[2]", "[2]", 1);
+    TEST_ONE_PATCH("[1]", "{\"a\":null,\"b\":2}", "{\"b\":2}", 1);
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_PATCH_H
+#define TEST_PATCH_H
+
+int test_patch(void);
+
+#endif
@@ -0,0 +1,132 @@
+#include "test_pointer.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int test_one_pointer(char* s, char* pointer, char* expect_s)
+{
+    int ret = 0;
+    ujson_t* json = NULL;
+    ujson_t* target;
+    ujson_pointer_t* ptr = NULL;
+    char* json_str = NULL;
+    ujson_size_t json_str_len;
+
+    if ((json = ujson_parse(s, strlen(s))) == NULL)
+    {
+        return -1;
+    }
+
+    if ((ptr = ujson_pointer_compile(pointer, strlen(pointer))) == NULL)
+    {
+        ret = -1;
+        goto fail;
+    }
+
+    target = ujson_pointer_get(json, ptr);
+    if (expect_s == NULL)
+    {
+        ret = (target == NULL) ? 0 : -1;
+        goto fail;
+    }
+    if (target == NULL)
+    {
+        ret = -1;
+        goto fail;
+    }
+
+    if (ujson_stringify(&json_str, &json_str_len, target) != 0)
+    {
+        ret = -1;
+        goto fail;
+    }
+
+    if ((json_str_len != strlen(expect_s)) ||
+        (strncmp(expect_s, json_str, json_str_len) != 0))
+    {
+        ret = -1;
+        goto fail;
+    }
+
+fail:
+    if (ptr != NULL)
+        ujson_pointer_destroy(ptr);
+    if (json != NULL)
+        ujson_destroy(json);
+    if (json_str != NULL)
+        free(json_str);
+    return ret;
+}
+
+#define TEST_ONE_POINTER(s, pointer, expect_s)                                 \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_pointer(s, pointer, expect_s) != 0)                       \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s pointer test failed\n",         \
+                    __FILE__, __LINE__, pointer);                              \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+#define TEST_ONE_POINTER_INVALID(pointer)                                      \
+    do                                                                         \
+    {                                                                          \
+        ujson_pointer_t* ptr;                                                  \
+        total++;                                                               \
+        if ((ptr = ujson_pointer_compile(pointer, strlen(pointer))) != NULL)   \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s should not compile\n",          \
+                    __FILE__, __LINE__, pointer);                              \
+            ujson_pointer_destroy(ptr);                                        \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+int test_pointer(void)
+{
+    int total = 0;
+    int passed = 0;
+
+    /* Whole document */
+    TEST_ONE_POINTER("[1,2]", "", "[1,2]");
+
+    /* Object */
+    TEST_ONE_POINTER("{\"a\":1}", "/a", "1");
+    TEST_ONE_POINTER("{\"a\":{\"b\":true}}", "/a/b", "true");
+    TEST_ONE_POINTER("{\"a\":1}", "/b", NULL);
+    TEST_ONE_POINTER("{\"\":1}", "/", "1");
+    TEST_ONE_POINTER("{\"a/b\":1}", "/a~1b", "1");
+    TEST_ONE_POINTER("{\"m~n\":1}", "/m~0n", "1");
+    TEST_ONE_POINTER("{\"3\":\"x\"}", "/3", "\"x\"");
+
+    /* Array */
+    TEST_ONE_POINTER("[1,2,3]", "/0", "1");
+    TEST_ONE_POINTER("[1,2,3]", "/2", "3");
+    TEST_ONE_POINTER("[1,2,3]", "/3", NULL);
+    TEST_ONE_POINTER("[1,2,3]", "/-", NULL);
+    TEST_ONE_POINTER("[1,2,3]", "/01", NULL);
+    TEST_ONE_POINTER("[1,2,3]", "/x", NULL);
+    TEST_ONE_POINTER("{\"a\":{\"b\":[0,1,2,3,{\"c\":null}]}}", "/a/b/4/c",
+                     "null");
+
+    /* Scalar */
+    TEST_ONE_POINTER("1", "/0", NULL);
+
+    /* Syntax */
+    TEST_ONE_POINTER_INVALID("a");
+    TEST_ONE_POINTER_INVALID("/~");
+    TEST_ONE_POINTER_INVALID("/~2");
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
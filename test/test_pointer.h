@@ -0,0 +1,6 @@
+#ifndef TEST_POINTER_H
+#define TEST_POINTER_H
+
+int test_pointer(void);
+
+#endif
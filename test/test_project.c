@@ -0,0 +1,136 @@
+#include "test_project.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int test_one_project(char* s, const char** paths, ujson_size_t count,
+                     char* expect_s)
+{
+    int ret = 0;
+    ujson_project_t* project = NULL;
+    ujson_t* json = NULL;
+    char* json_str = NULL;
+    ujson_size_t json_str_len;
+
+    if ((project = ujson_project_compile(paths, count)) == NULL)
+    {
+        return -1;
+    }
+
+    json = ujson_parse_project(s, strlen(s), project);
+    if (expect_s == NULL)
+    {
+        ret = (json == NULL) ? 0 : -1;
+        goto fail;
+    }
+    if (json == NULL)
+    {
+        ret = -1;
+        goto fail;
+    }
+
+    if (ujson_stringify(&json_str, &json_str_len, json) != 0)
+    {
+        ret = -1;
+        goto fail;
+    }
+
+    if ((json_str_len != strlen(expect_s)) ||
+        (strncmp(expect_s, json_str, json_str_len) != 0))
+    {
+        ret = -1;
+        goto fail;
+    }
+
+fail:
+    if (project != NULL)
+        ujson_project_destroy(project);
+    if (json != NULL)
+        ujson_destroy(json);
+    if (json_str != NULL)
+        free(json_str);
+    return ret;
+}
+
+#define TEST_ONE_PROJECT(s, paths, expect_s)                                   \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_project(s, paths, sizeof(paths) / sizeof(paths[0]),       \
+                             expect_s) != 0)                                   \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s project test failed\n",         \
+                    __FILE__, __LINE__, s);                                    \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+int test_project(void)
+{
+    int total = 0;
+    int passed = 0;
+
+    {
+        const char* paths[] = {"user.id", "event.ts", "tags[*]"};
+        TEST_ONE_PROJECT("{\"user\":{\"id\":7,\"name\":\"x\"},\"skip\":[1,{"
+                         "\"a\":\"b\"}],\"event\":{\"ts\":3},\"tags\":[1,2]}",
+                         paths, "{\"user\":{\"id\":7},\"event\":{\"ts\":3},"
+                                "\"tags\":[1,2]}");
+        TEST_ONE_PROJECT("{\"other\":1}", paths, "{}");
+        TEST_ONE_PROJECT("{\"user\":1,\"tags\":{\"a\":1}}", paths, "{}");
+        TEST_ONE_PROJECT("{\"user\":{\"id\":1}", paths, NULL);
+        TEST_ONE_PROJECT("{\"other\":[1,}", paths, NULL);
+        TEST_ONE_PROJECT("1", paths, NULL);
+    }
+
+    {
+        const char* paths[] = {"[1].name", "[*].id"};
+        TEST_ONE_PROJECT("[{\"id\":1,\"name\":\"a\"},{\"id\":2,\"name\":\"b\"}"
+                         ",{\"name\":\"c\"}]",
+                         paths,
+                         "[{\"id\":1},{\"id\":2,\"name\":\"b\"}]");
+    }
+
+    {
+        const char* paths[] = {"*.v"};
+        TEST_ONE_PROJECT("{\"a\":{\"v\":1,\"w\":2},\"b\":{\"w\":3},"
+                         "\"c\":{\"v\":[true]}}",
+                         paths, "{\"a\":{\"v\":1},\"c\":{\"v\":[true]}}");
+    }
+
+    {
+        const char* paths[] = {"a/b"};
+        TEST_ONE_PROJECT("{\"a\\/b\":1,\"a\\u0041\":2}", paths,
+                         "{\"a\\/b\":1}");
+    }
+
+    {
+        const char* paths[] = {"aA"};
+        TEST_ONE_PROJECT("{\"a\\u0041\":2,\"b\":3}", paths, "{\"aA\":2}");
+    }
+
+    /* An index past the range of ujson_size_t does not compile */
+    {
+        const char* paths[] = {"items[99999999999999999999999]"};
+        ujson_project_t* project = ujson_project_compile(paths, 1);
+        total++;
+        if (project == NULL)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: overflowed index compiled\n",
+                    __FILE__, __LINE__);
+            ujson_project_destroy(project);
+        }
+    }
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
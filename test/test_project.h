@@ -0,0 +1,6 @@
+#ifndef TEST_PROJECT_H
+#define TEST_PROJECT_H
+
+int test_project(void);
+
+#endif
@@ -0,0 +1,129 @@
+#include "test_reformat.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char* body;
+    size_t size;
+} test_reformat_output_t;
+
+static int test_reformat_write(void* data, const char* s, ujson_size_t len)
+{
+    test_reformat_output_t* output = (test_reformat_output_t*)data;
+    char* body = realloc(output->body, output->size + len + 1);
+    if (body == NULL)
+    {
+        return -1;
+    }
+    memcpy(body + output->size, s, len);
+    output->size += len;
+    body[output->size] = '\0';
+    output->body = body;
+    return 0;
+}
+
+/* expect_s is NULL when the input should be rejected */
+int test_one_reformat(char* s, char* expect_s, int repeat)
+{
+    int ret = 0;
+    test_reformat_output_t output;
+    ujson_stringify_config_t config;
+
+    output.body = NULL;
+    output.size = 0;
+    ujson_stringify_config_init(&config);
+    config.style = (repeat == 0) ? UJSON_STRINGIFY_CONFIG_STYLE_COMPACT
+                                 : UJSON_STRINGIFY_CONFIG_STYLE_INDENT;
+    config.repeat = repeat;
+    config.replacer = ' ';
+
+    if (ujson_reformat(s, strlen(s), &config, test_reformat_write, &output) !=
+        0)
+    {
+        ret = (expect_s == NULL) ? 0 : -1;
+        goto fail;
+    }
+    if ((expect_s == NULL) || (output.size != strlen(expect_s)) ||
+        (strncmp(expect_s, output.body, output.size) != 0))
+    {
+        ret = -1;
+        goto fail;
+    }
+
+fail:
+    if (output.body != NULL)
+        free(output.body);
+    return ret;
+}
+
+#define TEST_ONE_REFORMAT(s, expect_s, repeat)                                 \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_reformat(s, expect_s, repeat) != 0)                       \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s reformat test failed\n",        \
+                    __FILE__, __LINE__, s);                                    \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+int test_reformat(void)
+{
+    int total = 0, passed = 0;
+
+    /* Minify */
+    TEST_ONE_REFORMAT(" 1 ", "1", 0);
+    TEST_ONE_REFORMAT(" [ 1 , 2.50 , \"a b\" , true ] ",
+                      "[1,2.50,\"a b\",true]", 0);
+    TEST_ONE_REFORMAT("{ \"a\" : { } , \"b\" : [ ] , \"c\\n\" : null }",
+                      "{\"a\":{},\"b\":[],\"c\\n\":null}", 0);
+
+    /* Pretty */
+    TEST_ONE_REFORMAT("{\"a\":[1,{\"b\":2}],\"c\":{}}",
+                      "{\n  \"a\": [\n    1,\n    {\n      \"b\": 2\n    }\n"
+                      "  ],\n  \"c\": {}\n}",
+                      2);
+
+    /* Invalid */
+    TEST_ONE_REFORMAT("[1,]", NULL, 0);
+    TEST_ONE_REFORMAT("{\"a\" 1}", NULL, 0);
+    TEST_ONE_REFORMAT("[1", NULL, 0);
+    TEST_ONE_REFORMAT("{} x", NULL, 0);
+
+    /* Large */
+    {
+        size_t count = 10000;
+        size_t i;
+        char* s = malloc(count * 4 + 3);
+        char* expect_s = malloc(count * 2 + 3);
+        char* p = s;
+        char* q = expect_s;
+        *p++ = '[';
+        *q++ = '[';
+        for (i = 0; i != count; i++)
+        {
+            memcpy(p, (i == 0) ? " 7  " : ", 7 ", 4);
+            p += 4;
+            memcpy(q, (i == 0) ? "7" : ",7", (i == 0) ? 1 : 2);
+            q += (i == 0) ? 1 : 2;
+        }
+        *p++ = ']';
+        *p = '\0';
+        *q++ = ']';
+        *q = '\0';
+        TEST_ONE_REFORMAT(s, expect_s, 0);
+        free(s);
+        free(expect_s);
+    }
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_REFORMAT_H
+#define TEST_REFORMAT_H
+
+int test_reformat(void);
+
+#endif
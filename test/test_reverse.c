@@ -4,7 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 
-int test_one_reverse(char* s, char* expect_s)
+int test_one_reverse_ex(char* s, char* expect_s,
+                        ujson_parse_config_t* config)
 {
     int ret = 0;
     size_t len = strlen(s);
@@ -13,7 +14,8 @@ int test_one_reverse(char* s, char* expect_s)
     char* json_str = NULL;
     ujson_size_t json_str_len;
 
-    if ((json = ujson_parse(s, len)) == NULL)
+    if ((json = (config == NULL) ? ujson_parse(s, len)
+                                 : ujson_parse_ex(s, len, config)) == NULL)
     {
         return -1;
     }
@@ -44,6 +46,26 @@ fail:
     return ret;
 }
 
+int test_one_reverse(char* s, char* expect_s)
+{
+    return test_one_reverse_ex(s, expect_s, NULL);
+}
+
+#define TEST_ONE_REVERSE_EX(s, expect_s, config)                               \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_reverse_ex(s, expect_s, config) != 0)                     \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s reverse test failed\n",         \
+                    __FILE__, __LINE__, s);                                    \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
 #define TEST_ONE_REVERSE(s, expect_s)                                          \
     do                                                                         \
     {                                                                          \
@@ -59,6 +81,108 @@ fail:
         }                                                                      \
     } while (0);
 
+typedef void (*test_reverse_vary_t)(size_t run,
+                                    ujson_parse_config_t* parse_config,
+                                    ujson_stringify_config_t* config);
+
+/* Parse and stringify each {input, expected} case of a table, rounds
+ * times with vary adjusting the configs before every run. A NULL
+ * expectation means the input must be rejected; padded parsing gets
+ * its input followed by UJSON_PADDING zero bytes */
+static int test_reverse_table(const char* (*cases)[2], size_t count,
+                              size_t rounds, test_reverse_vary_t vary,
+                              ujson_parse_config_t* parse_config,
+                              ujson_stringify_config_t* config,
+                              const char* name, int* total)
+{
+    int passed = 0;
+    ujson_t* json;
+    char* json_str;
+    ujson_size_t json_str_len;
+    size_t len;
+    size_t i;
+    char* s;
+    for (i = 0; i != count * rounds; i++)
+    {
+        const char* input = cases[i / rounds][0];
+        const char* expect_s = cases[i / rounds][1];
+        vary(i, parse_config, config);
+        len = strlen(input);
+        s = malloc(len + UJSON_PADDING);
+        memcpy(s, input, len);
+        memset(s + len, 0, UJSON_PADDING);
+        (*total)++;
+        json = ujson_parse_ex(s, len, parse_config);
+        json_str = NULL;
+        if ((expect_s == NULL)
+                ? (json == NULL)
+                : ((json != NULL) &&
+                   (ujson_stringify_ex(&json_str, &json_str_len, json,
+                                       config) == 0) &&
+                   (json_str_len == strlen(expect_s)) &&
+                   (strncmp(json_str, expect_s, json_str_len) == 0)))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: %s %s test failed\n", __FILE__,
+                    __LINE__, input, name);
+        }
+        if (json != NULL)
+            ujson_destroy(json);
+        if (json_str != NULL)
+            free(json_str);
+        free(s);
+    }
+    return passed;
+}
+
+/* Every case both decoded and lazily kept escaped */
+static void test_reverse_vary_lazy_string(size_t run,
+                                          ujson_parse_config_t* parse_config,
+                                          ujson_stringify_config_t* config)
+{
+    (void)config;
+    parse_config->lazy_string = (run % 2 == 0) ? ujson_false : ujson_true;
+}
+
+/* Every case both converted and lazily kept as lexemes */
+static void test_reverse_vary_lazy(size_t run,
+                                   ujson_parse_config_t* parse_config,
+                                   ujson_stringify_config_t* config)
+{
+    (void)config;
+    parse_config->lazy_number = (run % 2 == 0) ? ujson_false : ujson_true;
+    parse_config->lazy_string = parse_config->lazy_number;
+}
+
+/* Every case both in input order and sorted */
+static void test_reverse_vary_canonical(size_t run,
+                                        ujson_parse_config_t* parse_config,
+                                        ujson_stringify_config_t* config)
+{
+    (void)parse_config;
+    config->canonical = (run % 2 == 0) ? ujson_false : ujson_true;
+}
+
+/* Alternate cases scanned lazily and decoded */
+static void test_reverse_vary_padded(size_t run,
+                                     ujson_parse_config_t* parse_config,
+                                     ujson_stringify_config_t* config)
+{
+    (void)config;
+    parse_config->lazy_string = (run % 2 == 0) ? ujson_true : ujson_false;
+}
+
+#define TEST_REVERSE_TABLE(cases, rounds, vary, parse_config, config, name)    \
+    do                                                                         \
+    {                                                                          \
+        passed += test_reverse_table(cases, sizeof(cases) / sizeof(cases[0]), \
+                                     rounds, vary, parse_config, config, name, \
+                                     &total);                                  \
+    } while (0);
+
 int test_reverse(void)
 {
     int total = 0;
@@ -77,6 +201,10 @@ int test_reverse(void)
     TEST_ONE_REVERSE(" -123", "-123");
     TEST_ONE_REVERSE("-123 ", "-123");
     TEST_ONE_REVERSE(" -123 ", "-123");
+    TEST_ONE_REVERSE("1.5", "1.500000000000");
+    TEST_ONE_REVERSE("-2.25", "-2.250000000000");
+    TEST_ONE_REVERSE("1e2", "100.000000000000");
+    TEST_ONE_REVERSE("[1E-2]", "[0.010000000000]");
 
     /* Null */
     TEST_ONE_REVERSE("null", "null");
@@ -110,6 +238,9 @@ int test_reverse(void)
     TEST_ONE_REVERSE("\"\\r\"", "\"\\r\"");
     TEST_ONE_REVERSE("\"\\t\"", "\"\\t\"");
     TEST_ONE_REVERSE("\"知道\"", "\"知道\"");
+    TEST_ONE_REVERSE("\"\\u0001\"", "\"\\u0001\"");
+    TEST_ONE_REVERSE("\"a clean run longer than a word, then a/b\\n知道\"",
+                     "\"a clean run longer than a word, then a\\/b\\n知道\"");
 
     /* Array */
     TEST_ONE_REVERSE("[]", "[]");
@@ -128,6 +259,9 @@ int test_reverse(void)
     TEST_ONE_REVERSE("[1 , 2]", "[1,2]");
     TEST_ONE_REVERSE("[1,2,3]", "[1,2,3]");
     TEST_ONE_REVERSE(" [ 1 , 2 , 3 ] ", "[1,2,3]");
+    TEST_ONE_REVERSE("[true,false,null,undefined]",
+                     "[true,false,null,undefined]");
+    TEST_ONE_REVERSE("\t[\r\n{ }, [ [] ] ]\n", "[{},[[]]]");
 
     /* Object */
     TEST_ONE_REVERSE("{}", "{}");
@@ -145,6 +279,229 @@ int test_reverse(void)
     TEST_ONE_REVERSE(" { \"one\" : 1 , \"two\" : 2 , \"three\" : 3 } ",
                      "{\"one\":1,\"two\":2,\"three\":3}");
 
+    /* Lazy number */
+    {
+        ujson_parse_config_t config;
+        ujson_t* json;
+        memset(&config, 0, sizeof(config));
+        config.lazy_number = ujson_true;
+        TEST_ONE_REVERSE_EX("123", "123", &config);
+        TEST_ONE_REVERSE_EX("-0.50", "-0.50", &config);
+        TEST_ONE_REVERSE_EX("12345678901234567890", "12345678901234567890",
+                            &config);
+        TEST_ONE_REVERSE_EX(" [ 1.0e+3 , {\"a\" : -7E-2} ] ",
+                            "[1.0e+3,{\"a\":-7E-2}]", &config);
+        total++;
+        json = ujson_parse_ex("[42, 2.5e1]", 11, &config);
+        if ((json != NULL) &&
+            (ujson_as_integer_value(ujson_as_array_item_value(
+                 ujson_as_array_first(json))) == 42) &&
+            (ujson_as_double_value(ujson_as_array_item_value(
+                 ujson_as_array_next(ujson_as_array_first(json)))) == 25.0))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: lazy number value failed\n",
+                    __FILE__, __LINE__);
+        }
+        if (json != NULL)
+            ujson_destroy(json);
+    }
+
+    /* Lazy string */
+    {
+        ujson_parse_config_t config;
+        ujson_t* json;
+        ujson_t* value;
+        memset(&config, 0, sizeof(config));
+        config.lazy_string = ujson_true;
+        TEST_ONE_REVERSE_EX("\"\"", "\"\"", &config);
+        TEST_ONE_REVERSE_EX("\"a/b\\u0041\"", "\"a/b\\u0041\"", &config);
+        TEST_ONE_REVERSE_EX(" { \"k\\n\" : [ \"\\\"\" ] } ",
+                            "{\"k\\n\":[\"\\\"\"]}", &config);
+        total++;
+        json = ujson_parse_ex("[\"\\u0041\\/\", \"知道\"]",
+                              strlen("[\"\\u0041\\/\", \"知道\"]"), &config);
+        if ((json != NULL) &&
+            ((value = ujson_as_array_item_value(ujson_as_array_first(json))) !=
+             NULL) &&
+            (ujson_as_string_size_in_utf8_bytes(value) == 2) &&
+            (strcmp(ujson_as_string_body(value), "A/") == 0) &&
+            ((value = ujson_as_array_item_value(
+                  ujson_as_array_next(ujson_as_array_first(json)))) != NULL) &&
+            (ujson_as_string_size_in_character(value) == 2) &&
+            (ujson_as_string_size_in_utf8_bytes(value) == 6))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: lazy string value failed\n",
+                    __FILE__, __LINE__);
+        }
+        if (json != NULL)
+            ujson_destroy(json);
+    }
+
+    /* Parallel parse */
+    {
+        ujson_parse_config_t config;
+        const char* element = "{\"a\":[1,\"x,]\\\"\"]}";
+        size_t element_len = strlen(element);
+        size_t count = 100000;
+        size_t i;
+        char* s = malloc((element_len + 1) * count + 2);
+        char* p = s;
+        *p++ = '[';
+        for (i = 0; i != count; i++)
+        {
+            if (i != 0)
+                *p++ = ',';
+            memcpy(p, element, element_len);
+            p += element_len;
+        }
+        *p++ = ']';
+        *p = '\0';
+        memset(&config, 0, sizeof(config));
+        config.threads = 4;
+        TEST_ONE_REVERSE_EX(s, s, &config);
+        config.lazy_number = ujson_true;
+        config.lazy_string = ujson_true;
+        TEST_ONE_REVERSE_EX(s, s, &config);
+        *(p - 1) = ',';
+        total++;
+        if (ujson_parse_ex(s, strlen(s), &config) == NULL)
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: unterminated array parsed\n",
+                    __FILE__, __LINE__);
+        }
+        free(s);
+    }
+
+    /* ASCII only */
+    {
+        static const char* cases[][2] = {
+            {"\"知道\"", "\"\\u77e5\\u9053\""},
+            {"\"a\xf0\x9f\x98\x80" "b\"", "\"a\\ud83d\\ude00b\""},
+            {"{\"caf\xc3\xa9\":\"\\n\xc3\xa9\"}",
+             "{\"caf\\u00e9\":\"\\n\\u00e9\"}"},
+            {"[\"a word of ascii then \xc3\xa9\",\"\\t\xc3\xa9\"]",
+             "[\"a word of ascii then \\u00e9\",\"\\t\\u00e9\"]"},
+        };
+        ujson_parse_config_t parse_config;
+        ujson_stringify_config_t config;
+        memset(&parse_config, 0, sizeof(parse_config));
+        ujson_stringify_config_init(&config);
+        config.ascii_only = ujson_true;
+        TEST_REVERSE_TABLE(cases, 2, test_reverse_vary_lazy_string,
+                           &parse_config, &config, "ascii only");
+    }
+
+    /* A config starts from its defaults whatever it held before */
+    {
+        static const char s[] = "{\"b\":\"\xc3\xa9\",\"a\":[1,2]}";
+        ujson_stringify_config_t config;
+        ujson_t* json;
+        char* json_str = NULL;
+        ujson_size_t json_str_len;
+        memset(&config, 0xff, sizeof(config));
+        ujson_stringify_config_init(&config);
+        total++;
+        json = ujson_parse((char*)s, strlen(s));
+        if ((json != NULL) &&
+            (ujson_stringify_ex(&json_str, &json_str_len, json, &config) ==
+             0) &&
+            (json_str_len == strlen(s)) &&
+            (strncmp(json_str, s, json_str_len) == 0))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: config defaults test failed\n",
+                    __FILE__, __LINE__);
+        }
+        if (json != NULL)
+            ujson_destroy(json);
+        if (json_str != NULL)
+            free(json_str);
+    }
+
+    /* Canonical */
+    {
+        static const char* cases[][2] = {
+            {"{\"b\":1,\"a\":[2.50,1e2,-0.0,1E-7,4.5e-3],"
+             "\"c\":{\"z\":null,\"y\":\"\\u0041/\\u00e9\\n\"}}",
+             "{\"a\":[2.5,100,0,1e-7,0.0045],\"b\":1,"
+             "\"c\":{\"y\":\"A/\xc3\xa9\\n\",\"z\":null}}"},
+            {"[333333333.33333329,1E30,0.1,1e21,1e-6,123456789012345678901234]",
+             "[333333333.3333333,1e+30,0.1,1e+21,0.000001,"
+             "1.2345678901234569e+23]"},
+            {"{\"\xe2\x82\xac\":1,\"\xef\xac\xb3\":2,"
+             "\"\xf0\x9f\x98\x80\":3,\"1\":4}",
+             "{\"1\":4,\"\xe2\x82\xac\":1,\"\xf0\x9f\x98\x80\":3,"
+             "\"\xef\xac\xb3\":2}"},
+        };
+        ujson_parse_config_t parse_config;
+        ujson_stringify_config_t config;
+        memset(&parse_config, 0, sizeof(parse_config));
+        ujson_stringify_config_init(&config);
+        config.canonical = ujson_true;
+        TEST_REVERSE_TABLE(cases, 2, test_reverse_vary_lazy, &parse_config,
+                           &config, "canonical");
+    }
+
+    /* Indent */
+    {
+        static const char* cases[][2] = {
+            {"{\"a\":[1,{\"b\":2}],\"c\":{},\"d\":[]}",
+             "{\n  \"a\": [\n    1,\n    {\n      \"b\": 2\n    }\n  ],\n"
+             "  \"c\": {},\n  \"d\": []\n}"},
+            {"[[[[[[[[\"deep\"]]]]]]]]",
+             "[\n  [\n    [\n      [\n        [\n          [\n            [\n"
+             "              [\n                \"deep\"\n              ]\n"
+             "            ]\n          ]\n        ]\n      ]\n    ]\n  ]\n]"},
+            {"true", "true"},
+        };
+        ujson_parse_config_t parse_config;
+        ujson_stringify_config_t config;
+        memset(&parse_config, 0, sizeof(parse_config));
+        ujson_stringify_config_init(&config);
+        parse_config.lazy_number = ujson_true;
+        config.style = UJSON_STRINGIFY_CONFIG_STYLE_INDENT;
+        config.repeat = 2;
+        config.replacer = ' ';
+        TEST_REVERSE_TABLE(cases, 2, test_reverse_vary_canonical,
+                           &parse_config, &config, "indent");
+    }
+
+    /* Padded input */
+    {
+        static const char* cases[][2] = {
+            {" [ 1 , -2.5e1 , 0 ] ", "[1,-25.000000000000,0]"},
+            {"{\"long string past one word\":\"x\\ty\"}",
+             "{\"long string past one word\":\"x\\ty\"}"},
+            {"[\"a\", \"bcdefghijklmnopq\", true]",
+             "[\"a\",\"bcdefghijklmnopq\",true]"},
+            {"\"unterminated", NULL},
+            {"[1, 2", NULL},
+            {"[\"ab\\", NULL},
+        };
+        ujson_parse_config_t parse_config;
+        ujson_stringify_config_t config;
+        memset(&parse_config, 0, sizeof(parse_config));
+        ujson_stringify_config_init(&config);
+        parse_config.padded = ujson_true;
+        TEST_REVERSE_TABLE(cases, 1, test_reverse_vary_padded, &parse_config,
+                           &config, "padded");
+    }
+
     printf("%d of %d cases passed\n", passed, total);
 
     return 0;
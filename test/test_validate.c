@@ -0,0 +1,101 @@
+#include "test_validate.h"
+#include "ujson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* err_offset is (size_t)-1 for input that should be valid */
+int test_one_validate(char* s, size_t expect_err_offset)
+{
+    ujson_size_t err_offset = 0;
+    int ret = ujson_validate(s, strlen(s), &err_offset);
+
+    if (expect_err_offset == (size_t)-1)
+    {
+        return (ret == 0) ? 0 : -1;
+    }
+    if ((ret == 0) || (err_offset != expect_err_offset))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+#define TEST_ONE_VALIDATE(s, expect_err_offset)                                \
+    do                                                                         \
+    {                                                                          \
+        total++;                                                               \
+        if (test_one_validate(s, expect_err_offset) != 0)                      \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: assert: %s validate test failed\n",        \
+                    __FILE__, __LINE__, s);                                    \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            passed++;                                                          \
+        }                                                                      \
+    } while (0);
+
+#define VALID ((size_t)-1)
+
+int test_validate(void)
+{
+    int total = 0, passed = 0;
+
+    /* Valid */
+    TEST_ONE_VALIDATE(" {\"a\" : [1, -0.5e+3, true, false, null, {}, []]} ",
+                      VALID);
+    TEST_ONE_VALIDATE("\"plain ascii string longer than a word\"", VALID);
+    TEST_ONE_VALIDATE("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\"", VALID);
+    TEST_ONE_VALIDATE("\"\xc3\xa9\xe7\x9f\xa5\xf0\x9f\x98\x80\"", VALID);
+    TEST_ONE_VALIDATE("[[[{\"a\":[{}]}]]]", VALID);
+
+    /* Grammar */
+    TEST_ONE_VALIDATE("", 0);
+    TEST_ONE_VALIDATE("[1,]", 3);
+    TEST_ONE_VALIDATE("{\"a\":1,}", 7);
+    TEST_ONE_VALIDATE("{\"a\" 1}", 5);
+    TEST_ONE_VALIDATE("[1 2]", 3);
+    TEST_ONE_VALIDATE("[1", 2);
+    TEST_ONE_VALIDATE("01", 1);
+    TEST_ONE_VALIDATE("1.", 2);
+    TEST_ONE_VALIDATE("1e", 2);
+    TEST_ONE_VALIDATE("tru", 0);
+    TEST_ONE_VALIDATE("undefined", 0);
+    TEST_ONE_VALIDATE("{} x", 3);
+    TEST_ONE_VALIDATE("\"\\x\"", 1);
+    TEST_ONE_VALIDATE("\"a\tb\"", 2);
+
+    /* UTF-8 */
+    TEST_ONE_VALIDATE("\"\xc0\xaf\"", 1);
+    TEST_ONE_VALIDATE("\"\xe0\x80\xaf\"", 1);
+    TEST_ONE_VALIDATE("\"\xed\xa0\x80\"", 1);
+    TEST_ONE_VALIDATE("\"\xf4\x90\x80\x80\"", 1);
+    TEST_ONE_VALIDATE("\"\xf8\x88\x80\x80\x80\"", 1);
+    TEST_ONE_VALIDATE("\"abcdefgh\xc3(\"", 9);
+    TEST_ONE_VALIDATE("\"\x80\"", 1);
+
+    /* Depth */
+    {
+        static char s[2 * 1025];
+        ujson_size_t err_offset;
+        memset(s, '[', 1025);
+        memset(s + 1025, ']', 1025);
+        total++;
+        if ((ujson_validate(s + 1, 2 * 1024, NULL) == 0) &&
+            (ujson_validate(s, 2 * 1025, &err_offset) != 0) &&
+            (err_offset == 1024))
+        {
+            passed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: assert: depth limit failed\n", __FILE__,
+                    __LINE__);
+        }
+    }
+
+    printf("%d of %d cases passed\n", passed, total);
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_VALIDATE_H
+#define TEST_VALIDATE_H
+
+int test_validate(void);
+
+#endif